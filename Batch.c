@@ -0,0 +1,483 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <SDL.h>
+
+#include "GIF_Decoder.h"
+#include "GIF_Pool.h"
+#include "GIF_Thumb.h"
+
+
+/* Batch [-j threads] [-m mode] [-o dir] [-s size] [-l list] path...
+ * Process every GIF of the paths (directories are walked) on a pool :
+ *   probe     size of the logical screen, only the header is read
+ *   validate  decode every image, no compositing
+ *   render    composite every frame, print a checksum of the frames
+ *   thumb     thumbnail of the first frame, written in dir as a PPM
+ * One line is printed per file, the throughput at the end.
+ */
+
+enum {
+  SDL_FLAGS = SDL_INIT_VIDEO,
+  
+  BUFSZ = 65536,          /* Bytes read from a file at once */
+  WINDOW = 4096,          /* Files submitted to the pool at once */
+  DEFAULT_SIZE = 128
+};
+
+enum {
+  MODE_PROBE,
+  MODE_VALIDATE,
+  MODE_RENDER,
+  MODE_THUMB
+};
+
+/* Kept by each worker from one file to the next */
+typedef struct {
+  GIF_Decoder * ctx;
+  Uint8 * buf;
+  
+  /* Current file */
+  Uint16 w;
+  Uint16 h;
+  Uint32 nframes;
+  Uint64 hash;
+  FILE * thumb;
+  Uint8 * row;            /* A row of the thumbnail, in RGB */
+} Worker;
+
+typedef struct {
+  int mode;
+  char * dir;
+  Uint16 size;
+  Worker * workers;
+  SDL_mutex * lock;
+  
+  /* Totals */
+  Uint32 ok;
+  Uint32 failed;
+  Uint64 bytes;
+  Uint64 frames;
+} Batch;
+
+typedef struct {
+  Batch * b;
+  char * path;
+} Job;
+
+
+
+Sint32 init(void) {
+  /* No window is opened, the canvases don't depend on the display */
+  if (getenv("SDL_VIDEODRIVER") == NULL)
+    putenv("SDL_VIDEODRIVER=dummy");
+  
+  if (SDL_Init(SDL_FLAGS) < 0) {
+    fprintf(stderr, "SDL_Init : %s\n", SDL_GetError());
+    return -1;
+  }
+  atexit(SDL_Quit);
+  
+  return 0;
+}
+
+
+
+/* #pragma mark Callbacks */
+
+/* FNV-1a of the rows of each frame */
+void renderFrame(void * data, SDL_Surface * canvas, Uint32 frame,
+                 Uint16 delay) {
+  Worker * w = data;
+  Uint8 * p;
+  Uint32 x, y, n;
+  
+  w->nframes++;
+  if (canvas == NULL)
+    return;
+  
+  n = canvas->w * canvas->format->BytesPerPixel;
+  for (y = 0; y < (Uint32)canvas->h; y++) {
+    p = (Uint8 *)canvas->pixels + y * canvas->pitch;
+    for (x = 0; x < n; x++) {
+      w->hash ^= p[x];
+      w->hash *= 1099511628211ULL;
+    }
+  }
+  w->hash ^= delay;
+  w->hash *= 1099511628211ULL;
+  (void)frame;
+}
+
+void thumbFrame(void * data, const Uint8 * rgba, Uint16 w, Uint16 h,
+                Uint32 frame, Uint16 delay) {
+  Worker * wk = data;
+  Uint32 x, y;
+  
+  wk->w = w;
+  wk->h = h;
+  wk->nframes++;
+  fprintf(wk->thumb, "P6\n%u %u\n255\n", w, h);
+  for (y = 0; y < h; y++) {
+    for (x = 0; x < w; x++, rgba += 4) {
+      wk->row[3 * x] = rgba[0];
+      wk->row[3 * x + 1] = rgba[1];
+      wk->row[3 * x + 2] = rgba[2];
+    }
+    fwrite(wk->row, 1, 3 * w, wk->thumb);
+  }
+  (void)frame;
+  (void)delay;
+}
+
+
+
+/* #pragma mark Jobs */
+
+/* Push the file in the decoder of the worker, 'bytes' is the size read */
+int decodeFile(Worker * w, FILE * fp, int mode, Uint64 * bytes) {
+  size_t n;
+  int ret;
+  
+  GIF_DecoderReset(w->ctx);
+  
+  /* Probe : header, logical screen descriptor and global color table */
+  if (mode == MODE_PROBE) {
+    n = fread(w->buf, 1, 13, fp);
+    if (n == 13 && (w->buf[10] & 0x80))
+      n += fread(w->buf + 13, 1, 3 << ((w->buf[10] & 0x7) + 1), fp);
+    *bytes += n;
+    if (GIF_DecoderPush(w->ctx, w->buf, n) < 0)
+      return -1;
+    w->w = GIF_DecoderGetWidth(w->ctx);
+    w->h = GIF_DecoderGetHeight(w->ctx);
+    return w->w != 0 ? 0 : -1;
+  }
+  
+  while (1) {
+    n = fread(w->buf, 1, BUFSZ, fp);
+    *bytes += n;
+    if (n == 0) {
+      fprintf(stderr, "decodeFile : Unexpected end of file.\n");
+      return -1;
+    }
+    
+    ret = GIF_DecoderPush(w->ctx, w->buf, n);
+    w->w = GIF_DecoderGetWidth(w->ctx);
+    w->h = GIF_DecoderGetHeight(w->ctx);
+    if (ret != 0)
+      return ret < 0 ? -1 : 0;
+  }
+}
+
+char * thumbName(Batch * b, char * path) {
+  char * name = strrchr(path, '/');
+  char * s;
+  
+  name = name == NULL ? path : name + 1;
+  s = malloc(strlen(b->dir) + strlen(name) + 6);
+  if (s != NULL)
+    sprintf(s, "%s/%s.ppm", b->dir, name);
+  return s;
+}
+
+void runJob(void * data, int worker) {
+  Job * job = data;
+  Batch * b = job->b;
+  Worker * w = &b->workers[worker];
+  Uint64 bytes = 0;
+  Uint32 t0 = SDL_GetTicks();
+  char * name;
+  FILE * fp;
+  struct stat st;
+  int ret = -1;
+  
+  w->w = 0;
+  w->h = 0;
+  w->nframes = 0;
+  w->hash = 14695981039346656037ULL;
+  
+  if (b->mode == MODE_THUMB) {
+    name = thumbName(b, job->path);
+    w->thumb = name != NULL ? fopen(name, "wb") : NULL;
+    if (w->thumb != NULL) {
+      ret = GIF_ThumbnailEx(w->ctx, w->buf, BUFSZ, job->path, b->size, 1,
+                            thumbFrame, w) == 1 ? 0 : -1;
+      if (fclose(w->thumb) != 0)
+        ret = -1;
+    }
+    free(name);
+    if (stat(job->path, &st) == 0)
+      bytes = st.st_size;
+  }
+  else {
+    fp = fopen(job->path, "rb");
+    if (fp != NULL) {
+      ret = decodeFile(w, fp, b->mode, &bytes);
+      fclose(fp);
+    }
+  }
+  
+  SDL_LockMutex(b->lock);
+  
+  if (ret < 0) {
+    b->failed++;
+    printf("%s\tFAIL\n", job->path);
+  }
+  else {
+    b->ok++;
+    b->frames += w->nframes;
+    printf("%s\tOK\t%ux%u", job->path, w->w, w->h);
+    if (b->mode != MODE_PROBE)
+      printf("\t%u", w->nframes);
+    if (b->mode == MODE_RENDER)
+      printf("\t%016llx", (unsigned long long)w->hash);
+    printf("\t%ums\n", SDL_GetTicks() - t0);
+  }
+  b->bytes += bytes;
+  
+  SDL_UnlockMutex(b->lock);
+}
+
+
+
+/* #pragma mark Files */
+
+typedef struct {
+  Batch * b;
+  GIF_Pool * pool;
+  Job jobs[WINDOW];
+  Uint32 n;
+} Queue;
+
+void flushJobs(Queue * q) {
+  Uint32 i;
+  
+  for (i = 0; i < q->n; i++) {
+    if (GIF_PoolSubmit(q->pool, runJob, &q->jobs[i]) < 0) {
+      SDL_LockMutex(q->b->lock);
+      q->b->failed++;
+      printf("%s\tFAIL\n", q->jobs[i].path);
+      SDL_UnlockMutex(q->b->lock);
+    }
+  }
+  GIF_PoolWait(q->pool);
+  
+  for (i = 0; i < q->n; i++)
+    free(q->jobs[i].path);
+  q->n = 0;
+}
+
+void addFile(Queue * q, const char * path) {
+  Job * job = &q->jobs[q->n];
+  
+  job->b = q->b;
+  job->path = malloc(strlen(path) + 1);
+  if (job->path == NULL) {
+    perror("addFile : malloc");
+    return;
+  }
+  strcpy(job->path, path);
+  
+  if (++q->n == WINDOW)
+    flushJobs(q);
+}
+
+int isGIF(const char * name) {
+  size_t n = strlen(name);
+  const char * s = name + n - 4;
+  
+  return n > 4 && s[0] == '.' && (s[1] | 0x20) == 'g' &&
+         (s[2] | 0x20) == 'i' && (s[3] | 0x20) == 'f';
+}
+
+/* A file is always taken (and fails if missing), the GIF files of a
+ * directory are searched
+ */
+void addPath(Queue * q, const char * path) {
+  struct dirent * e;
+  struct stat st;
+  DIR * dir;
+  char * s;
+  
+  if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) {
+    addFile(q, path);
+    return;
+  }
+  
+  dir = opendir(path);
+  if (dir == NULL) {
+    perror(path);
+    return;
+  }
+  
+  while ((e = readdir(dir)) != NULL) {
+    if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
+      continue;
+    
+    s = malloc(strlen(path) + strlen(e->d_name) + 2);
+    if (s == NULL)
+      break;
+    sprintf(s, "%s/%s", path, e->d_name);
+    
+    if (stat(s, &st) == 0 && (S_ISDIR(st.st_mode) || isGIF(e->d_name)))
+      addPath(q, s);
+    free(s);
+  }
+  
+  closedir(dir);
+}
+
+/* One path per line, "-" for stdin */
+void addList(Queue * q, const char * list) {
+  char line[4096];
+  FILE * fp;
+  size_t n;
+  
+  fp = strcmp(list, "-") == 0 ? stdin : fopen(list, "r");
+  if (fp == NULL) {
+    perror(list);
+    return;
+  }
+  
+  while (fgets(line, sizeof line, fp) != NULL) {
+    n = strlen(line);
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+      line[--n] = '\0';
+    if (n > 0)
+      addPath(q, line);
+  }
+  
+  if (fp != stdin)
+    fclose(fp);
+}
+
+
+
+void usage(char * name) {
+  fprintf(stderr, "usage : %s [-j threads] [-m probe|validate|render|thumb] "
+          "[-o dir] [-s size] [-l list] path...\n", name);
+}
+
+int main(int argc, char ** argv) {
+  const char * modes[] = { "probe", "validate", "render", "thumb" };
+  static Queue q;
+  Batch b;
+  Uint32 t0, t;
+  double sec;
+  int nthreads = 0;
+  int i, k;
+  
+  memset(&b, 0, sizeof b);
+  b.mode = MODE_VALIDATE;
+  b.size = DEFAULT_SIZE;
+  
+  for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i += 2) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    switch (argv[i][1]) {
+      case 'j':
+        nthreads = atoi(argv[i + 1]);
+        break;
+      
+      case 'm':
+        for (k = 0; k < 4 && strcmp(argv[i + 1], modes[k]) != 0; k++)
+          ;
+        b.mode = k;
+        break;
+      
+      case 'o':
+        b.dir = argv[i + 1];
+        break;
+      
+      case 's':
+        b.size = atoi(argv[i + 1]);
+        break;
+      
+      case 'l':
+        break;
+      
+      default:
+        b.mode = -1;
+        break;
+    }
+  }
+  
+  if (b.mode < 0 || b.mode > MODE_THUMB || b.size == 0 ||
+      (b.mode == MODE_THUMB && b.dir == NULL)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  
+  if (init() < 0)
+    return EXIT_FAILURE;
+  
+  if (nthreads <= 0)
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  q.b = &b;
+  q.pool = GIF_PoolCreate(nthreads);
+  b.lock = SDL_CreateMutex();
+  if (q.pool == NULL || b.lock == NULL)
+    return EXIT_FAILURE;
+  
+  /* A decoder and a buffer per worker, reused for every file */
+  nthreads = GIF_PoolSize(q.pool);
+  b.workers = calloc(nthreads, sizeof *b.workers);
+  if (b.workers == NULL)
+    return EXIT_FAILURE;
+  for (k = 0; k < nthreads; k++) {
+    b.workers[k].buf = malloc(BUFSZ);
+    b.workers[k].ctx = GIF_DecoderCreate(b.mode == MODE_RENDER ? 0 :
+                                         GIF_DECODER_NOCANVAS, renderFrame,
+                                         NULL, &b.workers[k]);
+    if (b.workers[k].buf == NULL || b.workers[k].ctx == NULL)
+      return EXIT_FAILURE;
+    
+    /* The thumbnail is never wider than 'size' */
+    if (b.mode == MODE_THUMB) {
+      b.workers[k].row = malloc(3 * b.size);
+      if (b.workers[k].row == NULL)
+        return EXIT_FAILURE;
+    }
+  }
+  
+  t0 = SDL_GetTicks();
+  
+  for (i = 1; i < argc; i++) {
+    if (argv[i][0] == '-' && argv[i][1] != '\0') {
+      if (argv[i][1] == 'l')
+        addList(&q, argv[i + 1]);
+      i++;
+    }
+    else
+      addPath(&q, argv[i]);
+  }
+  flushJobs(&q);
+  
+  t = SDL_GetTicks() - t0;
+  sec = t > 0 ? t / 1000.0 : 0.001;
+  
+  GIF_PoolFree(q.pool);
+  for (k = 0; k < nthreads; k++) {
+    GIF_DecoderFree(b.workers[k].ctx);
+    free(b.workers[k].buf);
+    free(b.workers[k].row);
+  }
+  free(b.workers);
+  SDL_DestroyMutex(b.lock);
+  
+  fflush(stdout);
+  fprintf(stderr, "%u files (%u failed), %.1f MB, %llu frames in %.2f s "
+          "with %d threads\n", b.ok + b.failed, b.failed, b.bytes / 1048576.0,
+          (unsigned long long)b.frames, sec, nthreads);
+  fprintf(stderr, "%.1f files/s, %.1f MB/s, %.1f frames/s\n",
+          (b.ok + b.failed) / sec, b.bytes / 1048576.0 / sec, b.frames / sec);
+  
+  return b.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,631 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <SDL.h>
+#include <gif_lib.h>
+
+/* DGifCloseFile with an error code, DGifSlurp de-interlacing */
+#if !defined(GIFLIB_MAJOR) || GIFLIB_MAJOR * 100 + GIFLIB_MINOR < 501
+# error "Compare needs giflib 5.1 or later"
+#endif
+
+#include "GIF_Struct.h"
+#include "GIF_Render.h"
+#include "GIF_Encode.h"
+
+
+/* Compare [-n runs] [-g count -o dir] [-b baseline] [-w baseline]
+ *         [-t percent] path...
+ * Decode every GIF of the paths (directories are walked) with this library
+ * and with giflib, compare the composited frames pixel by pixel and time
+ * both decoders, in full and in indexed loads. With -g, 'count' generated
+ * files are written in dir first and compared too : random sizes,
+ * positions, local tables, disposal methods, transparency and interlacing,
+ * then a file making the indexed palette compact under a saved canvas.
+ * giflib only gives the images : they are composited here with the rules
+ * the library follows (transparent canvas, no background color, disposal
+ * method 3 back to the canvas before the image). A misreading of those
+ * rules shared by both can't show, the comparison checks the decoding.
+ * The throughput is given relative to giflib, which doesn't depend on the
+ * machine : -w writes the ratios to a baseline, -b reads them back and fails
+ * if the total ratio dropped by more than -t percent. A baseline is only
+ * meaningful against the giflib it was written with.
+ * The exit status is non-zero if a frame differs or if the throughput
+ * regressed.
+ *   cc -O2 Compare.c GIF.c GIF_*.c `sdl-config --cflags --libs` -lgif
+ */
+
+enum {
+  SDL_FLAGS = SDL_INIT_VIDEO,
+  
+  DEFAULT_RUNS = 3,       /* Decodes per file, the fastest one counts */
+  DEFAULT_THRESHOLD = 10, /* Percent */
+  
+  STRESS_SEED = 1234,     /* The generated corpus is always the same */
+  STRESS_MAXSZ = 320,
+  STRESS_MAXFRAMES = 24
+};
+
+typedef struct {
+  char ** files;
+  Uint32 n;
+  Uint32 cap;
+} List;
+
+typedef struct {
+  Uint32 frames;
+  Uint32 diff;            /* Frames that differ */
+  Uint32 tOurs;           /* Best decode times (ms) */
+  Uint32 tGiflib;
+} Result;
+
+
+
+Sint32 init(void) {
+  /* No window is opened, the canvases don't depend on the display */
+  if (getenv("SDL_VIDEODRIVER") == NULL)
+    putenv("SDL_VIDEODRIVER=dummy");
+  
+  if (SDL_Init(SDL_FLAGS) < 0) {
+    fprintf(stderr, "SDL_Init : %s\n", SDL_GetError());
+    return -1;
+  }
+  atexit(SDL_Quit);
+  
+  return 0;
+}
+
+
+
+/* #pragma mark Files */
+
+int isGIF(const char * name) {
+  size_t n = strlen(name);
+  
+  return n > 4 && (strcmp(name + n - 4, ".gif") == 0 ||
+                   strcmp(name + n - 4, ".GIF") == 0);
+}
+
+void addFile(List * l, const char * path) {
+  char ** files;
+  
+  if (l->n == l->cap) {
+    l->cap = l->cap == 0 ? 64 : 2 * l->cap;
+    files = realloc(l->files, l->cap * sizeof *files);
+    if (files == NULL) {
+      perror("addFile : realloc");
+      exit(EXIT_FAILURE);
+    }
+    l->files = files;
+  }
+  
+  l->files[l->n] = malloc(strlen(path) + 1);
+  if (l->files[l->n] == NULL) {
+    perror("addFile : malloc");
+    exit(EXIT_FAILURE);
+  }
+  strcpy(l->files[l->n++], path);
+}
+
+/* A file is always taken, the GIF files of a directory are searched */
+void addPath(List * l, const char * path) {
+  struct dirent * e;
+  struct stat st;
+  DIR * dir;
+  char * s;
+  
+  if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) {
+    addFile(l, path);
+    return;
+  }
+  
+  dir = opendir(path);
+  if (dir == NULL) {
+    perror(path);
+    return;
+  }
+  
+  while ((e = readdir(dir)) != NULL) {
+    if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
+      continue;
+    
+    s = malloc(strlen(path) + strlen(e->d_name) + 2);
+    if (s == NULL)
+      break;
+    sprintf(s, "%s/%s", path, e->d_name);
+    
+    if (stat(s, &st) == 0 && (S_ISDIR(st.st_mode) || isGIF(e->d_name)))
+      addPath(l, s);
+    free(s);
+  }
+  
+  closedir(dir);
+}
+
+
+
+/* #pragma mark Stress corpus */
+
+Uint32 rnd(Uint32 n) {
+  return (Uint32)rand() % n;
+}
+
+/* Runs of random lengths, or noise : both LZW paths get exercised */
+void fillIndexes(Uint8 * idx, Uint32 n, Uint16 npal) {
+  Uint32 i = 0, run;
+  Uint8 c;
+  
+  while (i < n) {
+    c = rnd(npal);
+    run = rnd(4) == 0 ? 1 + rnd(64) : 1;
+    for (; run > 0 && i < n; run--)
+      idx[i++] = c;
+  }
+}
+
+void fillPalette(SDL_Color * pal, Uint16 n) {
+  Uint16 i;
+  
+  for (i = 0; i < n; i++) {
+    pal[i].r = rnd(256);
+    pal[i].g = rnd(256);
+    pal[i].b = rnd(256);
+  }
+}
+
+/* Frames that make the indexed store compact its palette while a canvas is
+ * saved for disposal method 3 : 200 global colors, then 50 new ones over
+ * them, then 160 new ones in an image restored afterwards.
+ */
+Sint32 generateCompact(List * l, const char * s) {
+  SDL_Color gcol[256];
+  SDL_Color lcol[256];
+  GIF_Encoder * enc;
+  GIF_Frame frm;
+  Uint8 idx[32 * 32];
+  Uint32 i, k;
+  static const Uint16 npal[4] = { 0, 50, 160, 0 };
+  static const Uint8 size[4] = { 32, 32, 16, 1 };
+  
+  fillPalette(gcol, 256);
+  enc = GIF_EncoderCreate((char *)s, 32, 32, gcol, 256, 0, 0);
+  if (enc == NULL)
+    return -1;
+  
+  for (k = 0; k < 4; k++) {
+    frm.x = frm.y = 0;
+    frm.w = frm.h = size[k];
+    frm.pal = NULL;
+    frm.npal = npal[k];
+    if (npal[k] != 0) {
+      fillPalette(lcol, npal[k]);
+      frm.pal = lcol;
+    }
+    for (i = 0; i < (Uint32)frm.w * frm.h; i++)
+      idx[i] = i % (npal[k] != 0 ? npal[k] : 200);
+    frm.idx = idx;
+    frm.delay = 10;
+    frm.dispMeth = k == 2 ? 3 : 1;
+    frm.transp = -1;
+    frm.interlace = 0;
+    
+    if (GIF_EncoderAddFrame(enc, &frm) < 0)
+      break;
+  }
+  
+  if (GIF_EncoderClose(enc) < 0 || k != 4)
+    return -1;
+  addFile(l, s);
+  
+  return 0;
+}
+
+/* Write 'count' files in dir, added to the list */
+Sint32 generate(List * l, const char * dir, Uint32 count) {
+  SDL_Color gcol[256];
+  SDL_Color lcol[256];
+  GIF_Encoder * enc;
+  GIF_Frame frm;
+  Uint8 * idx;
+  char * s;
+  Uint16 w, h, ngcol;
+  Uint32 i, k, nframes;
+  
+  idx = malloc(STRESS_MAXSZ * STRESS_MAXSZ);
+  s = malloc(strlen(dir) + 32);
+  if (idx == NULL || s == NULL) {
+    perror("generate : malloc");
+    free(idx);
+    free(s);
+    return -1;
+  }
+  
+  srand(STRESS_SEED);
+  for (i = 0; i < count; i++) {
+    sprintf(s, "%s/stress%04u.gif", dir, i);
+    w = 1 + rnd(STRESS_MAXSZ);
+    h = 1 + rnd(STRESS_MAXSZ);
+    ngcol = 2 << rnd(8);
+    fillPalette(gcol, ngcol);
+    
+    enc = GIF_EncoderCreate(s, w, h, gcol, ngcol, 0, 0);
+    if (enc == NULL)
+      break;
+    
+    nframes = 1 + rnd(STRESS_MAXFRAMES);
+    for (k = 0; k < nframes; k++) {
+      frm.w = 1 + rnd(w);
+      frm.h = 1 + rnd(h);
+      frm.x = rnd(w - frm.w + 1);
+      frm.y = rnd(h - frm.h + 1);
+      
+      frm.pal = NULL;
+      frm.npal = ngcol;
+      if (rnd(4) == 0) {
+        frm.npal = 2 << rnd(8);
+        fillPalette(lcol, frm.npal);
+        frm.pal = lcol;
+      }
+      
+      fillIndexes(idx, (Uint32)frm.w * frm.h, frm.npal);
+      frm.idx = idx;
+      frm.delay = rnd(20);
+      frm.dispMeth = rnd(4);
+      frm.transp = rnd(2) == 0 ? -1 : (Sint16)rnd(frm.npal);
+      frm.interlace = rnd(4) == 0;
+      
+      if (GIF_EncoderAddFrame(enc, &frm) < 0)
+        break;
+    }
+    
+    if (GIF_EncoderClose(enc) < 0 || k != nframes)
+      break;
+    addFile(l, s);
+  }
+  
+  if (i == count) {
+    sprintf(s, "%s/compact.gif", dir);
+    if (generateCompact(l, s) < 0)
+      i = 0;
+  }
+  
+  if (i != count)
+    fprintf(stderr, "generate : Writing %s failed.\n", s);
+  free(idx);
+  free(s);
+  
+  return i == count ? 0 : -1;
+}
+
+
+
+/* #pragma mark giflib */
+
+/* Composite the frames as the library does : 0x00RRGGBB pixels on a
+ * transparent canvas, the background color isn't used. If 'ref' isn't
+ * NULL, each frame is compared with it.
+ * Return the number of frames, -1 on error.
+ */
+Sint32 giflibDecode(const char * file, GIF_Surface * ref, Uint32 * diff) {
+  GraphicsControlBlock gcb;
+  GifFileType * g;
+  SavedImage * img;
+  ColorMapObject * cmap;
+  SDL_Surface * sfc;
+  Uint32 * canvas;
+  Uint32 * save;
+  Uint32 * row;
+  Uint8 * src;
+  Sint32 x0, x1, y0, y1, x, y, w, h;
+  Sint32 px0 = 0, px1 = 0, py0 = 0, py1 = 0;
+  int prevDisp = DISPOSAL_UNSPECIFIED;
+  int err, i, c;
+  
+  g = DGifOpenFileName(file, &err);
+  if (g == NULL) {
+    fprintf(stderr, "DGifOpenFileName : %s\n", GifErrorString(err));
+    return -1;
+  }
+  if (DGifSlurp(g) != GIF_OK) {
+    fprintf(stderr, "DGifSlurp : %s\n", GifErrorString(g->Error));
+    DGifCloseFile(g, &err);
+    return -1;
+  }
+  
+  w = g->SWidth;
+  h = g->SHeight;
+  canvas = malloc((size_t)w * h * sizeof *canvas + 1);
+  save = malloc((size_t)w * h * sizeof *save + 1);
+  if (canvas == NULL || save == NULL) {
+    perror("giflibDecode : malloc");
+    free(canvas);
+    free(save);
+    DGifCloseFile(g, &err);
+    return -1;
+  }
+  for (i = 0; i < w * h; i++)
+    canvas[i] = GIF_TRANSPARENT;
+  
+  for (i = 0; i < g->ImageCount; i++) {
+    img = &g->SavedImages[i];
+    gcb.DisposalMode = DISPOSAL_UNSPECIFIED;
+    gcb.TransparentColor = NO_TRANSPARENT_COLOR;
+    DGifSavedExtensionToGCB(g, i, &gcb);
+    
+    /* Previous image */
+    for (y = py0; y < py1; y++) {
+      if (prevDisp == DISPOSE_BACKGROUND)
+        for (x = px0; x < px1; x++)
+          canvas[y * w + x] = GIF_TRANSPARENT;
+      else if (prevDisp == DISPOSE_PREVIOUS)
+        memcpy(canvas + y * w + px0, save + y * w + px0,
+               (px1 - px0) * sizeof *canvas);
+    }
+    if (gcb.DisposalMode == DISPOSE_PREVIOUS)
+      memcpy(save, canvas, (size_t)w * h * sizeof *save);
+    
+    x0 = img->ImageDesc.Left;
+    y0 = img->ImageDesc.Top;
+    x1 = x0 + img->ImageDesc.Width < w ? x0 + img->ImageDesc.Width : w;
+    y1 = y0 + img->ImageDesc.Height < h ? y0 + img->ImageDesc.Height : h;
+    cmap = img->ImageDesc.ColorMap != NULL ? img->ImageDesc.ColorMap
+                                           : g->SColorMap;
+    
+    /* DGifSlurp gives the rows of interlaced images in order */
+    for (y = y0; y < y1; y++) {
+      src = img->RasterBits + (y - y0) * img->ImageDesc.Width;
+      for (x = x0; x < x1; x++) {
+        c = src[x - x0];
+        if (c == gcb.TransparentColor)
+          continue;
+        if (cmap == NULL || c >= cmap->ColorCount)
+          canvas[y * w + x] = 0;
+        else
+          canvas[y * w + x] = GIF_RGB(cmap->Colors[c].Red,
+                                      cmap->Colors[c].Green,
+                                      cmap->Colors[c].Blue);
+      }
+    }
+    
+    prevDisp = gcb.DisposalMode;
+    px0 = x0;
+    px1 = x1;
+    py0 = y0;
+    py1 = y1;
+    
+    if (ref == NULL)
+      continue;
+    
+    sfc = GIF_GetFrame(ref, i);
+    if (sfc == NULL || sfc->w != w || sfc->h != h) {
+      (*diff)++;
+      continue;
+    }
+    if (SDL_MUSTLOCK(sfc))
+      SDL_LockSurface(sfc);
+    for (y = 0; y < h; y++) {
+      row = GIF_ROW(sfc, y);
+      if (memcmp(row, canvas + y * w, w * sizeof *row) != 0)
+        break;
+    }
+    if (SDL_MUSTLOCK(sfc))
+      SDL_UnlockSurface(sfc);
+    if (y < h)
+      (*diff)++;
+  }
+  
+  free(canvas);
+  free(save);
+  i = g->ImageCount;
+  DGifCloseFile(g, &err);
+  
+  return i;
+}
+
+
+
+/* #pragma mark Comparison */
+
+Sint32 compare(const char * file, Uint32 runs, Result * r) {
+  GIF_Surface * gif;
+  Uint32 t, k;
+  Sint32 n;
+  
+  memset(r, 0, sizeof *r);
+  
+  gif = GIF_LoadGIF((char *)file);
+  if (gif == NULL) {
+    fprintf(stderr, "%s : GIF_LoadGIF failed.\n", file);
+    return -1;
+  }
+  r->frames = GIF_GetNumFrames(gif);
+  
+  n = giflibDecode(file, gif, &r->diff);
+  GIF_FreeGIF(gif);
+  if (n < 0)
+    return -1;
+  
+  /* The indexed store composites on its own, it is compared too */
+  gif = GIF_LoadGIFEx((char *)file, GIF_LOAD_INDEXED | GIF_LOAD_DELTA);
+  if (gif == NULL) {
+    fprintf(stderr, "%s : GIF_LoadGIFEx failed.\n", file);
+    return -1;
+  }
+  giflibDecode(file, gif, &r->diff);
+  GIF_FreeGIF(gif);
+  if ((Uint32)n != r->frames)
+    r->diff += (Uint32)n > r->frames ? n - r->frames : r->frames - n;
+  
+  r->tOurs = r->tGiflib = (Uint32)-1;
+  for (k = 0; k < runs; k++) {
+    t = SDL_GetTicks();
+    gif = GIF_LoadGIF((char *)file);
+    GIF_FreeGIF(gif);
+    t = SDL_GetTicks() - t;
+    if (t < r->tOurs)
+      r->tOurs = t;
+    
+    t = SDL_GetTicks();
+    giflibDecode(file, NULL, NULL);
+    t = SDL_GetTicks() - t;
+    if (t < r->tGiflib)
+      r->tGiflib = t;
+  }
+  
+  return 0;
+}
+
+/* Speed relative to giflib, the times are at least 1 ms */
+double ratio(Uint32 tOurs, Uint32 tGiflib) {
+  return (tGiflib > 0 ? tGiflib : 1) / (double)(tOurs > 0 ? tOurs : 1);
+}
+
+/* The line "total <ratio>" of a baseline, -1 if there is none */
+double readBaseline(const char * name) {
+  char key[4096];
+  double v, total = -1;
+  FILE * fp;
+  
+  fp = fopen(name, "r");
+  if (fp == NULL) {
+    perror(name);
+    return -1;
+  }
+  while (fscanf(fp, "%4095s %lf", key, &v) == 2)
+    if (strcmp(key, "total") == 0)
+      total = v;
+  fclose(fp);
+  
+  return total;
+}
+
+
+
+void usage(char * name) {
+  fprintf(stderr, "usage : %s [-n runs] [-g count -o dir] [-b baseline] "
+          "[-w baseline] [-t percent] path...\n", name);
+}
+
+int main(int argc, char ** argv) {
+  static List l;
+  Result r;
+  char * dir = NULL;
+  char * base = NULL;
+  char * out = NULL;
+  FILE * fp = NULL;
+  Uint32 runs = DEFAULT_RUNS;
+  Uint32 count = 0;
+  Uint32 threshold = DEFAULT_THRESHOLD;
+  Uint32 failed = 0, differ = 0;
+  Uint64 tOurs = 0, tGiflib = 0;
+  double prev = -1, total;
+  int i;
+  Uint32 k;
+  
+  for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i += 2) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    switch (argv[i][1]) {
+      case 'n':
+        runs = atoi(argv[i + 1]);
+        break;
+      
+      case 'g':
+        count = atoi(argv[i + 1]);
+        break;
+      
+      case 'o':
+        dir = argv[i + 1];
+        break;
+      
+      case 'b':
+        base = argv[i + 1];
+        break;
+      
+      case 'w':
+        out = argv[i + 1];
+        break;
+      
+      case 't':
+        threshold = atoi(argv[i + 1]);
+        break;
+      
+      default:
+        runs = 0;
+        break;
+    }
+  }
+  
+  if (runs == 0 || (count > 0 && dir == NULL) || (i == argc && count == 0)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  
+  if (init() < 0)
+    return EXIT_FAILURE;
+  
+  for (; i < argc; i++)
+    addPath(&l, argv[i]);
+  if (count > 0 && generate(&l, dir, count) < 0)
+    return EXIT_FAILURE;
+  
+  if (base != NULL) {
+    prev = readBaseline(base);
+    if (prev <= 0) {
+      fprintf(stderr, "Error: main: No total in %s !\n", base);
+      return EXIT_FAILURE;
+    }
+  }
+  if (out != NULL) {
+    fp = fopen(out, "w");
+    if (fp == NULL) {
+      perror(out);
+      return EXIT_FAILURE;
+    }
+  }
+  
+  for (k = 0; k < l.n; k++) {
+    if (compare(l.files[k], runs, &r) < 0) {
+      printf("%s\tFAILED\n", l.files[k]);
+      failed++;
+      continue;
+    }
+    
+    printf("%s\t%u frames\t%s\t%u ms\t%u ms (giflib)\t%.2fx\n", l.files[k],
+           r.frames, r.diff == 0 ? "same" : "DIFFERENT", r.tOurs, r.tGiflib,
+           ratio(r.tOurs, r.tGiflib));
+    if (r.diff != 0)
+      differ++;
+    tOurs += r.tOurs;
+    tGiflib += r.tGiflib;
+    
+    if (fp != NULL)
+      fprintf(fp, "%s %.3f\n", l.files[k], ratio(r.tOurs, r.tGiflib));
+  }
+  
+  total = ratio(tOurs, tGiflib);
+  if (fp != NULL) {
+    fprintf(fp, "total %.3f\n", total);
+    fclose(fp);
+  }
+  
+  fflush(stdout);
+  fprintf(stderr, "%u files (%u failed, %u different), %.2fx the speed of "
+          "giflib\n", l.n, failed, differ, total);
+  
+  if (prev > 0) {
+    fprintf(stderr, "baseline %.2fx, %+.1f %%\n", prev,
+            100 * (total - prev) / prev);
+    if (total < prev * (100 - threshold) / 100) {
+      fprintf(stderr, "Error: main: Throughput regressed !\n");
+      return EXIT_FAILURE;
+    }
+  }
+  
+  return failed || differ ? EXIT_FAILURE : EXIT_SUCCESS;
+}
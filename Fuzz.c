@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF.h"
+#include "GIF_Decoder.h"
+
+
+/* Fuzz target for libFuzzer (or AFL++, which builds the same entry point).
+ * Each input goes to the whole-file parser, from a padded copy as a file
+ * would be, then to the incremental decoder in small pieces. The last byte
+ * picks the size of the pieces (1 to 64) and the indexed load. A memory
+ * budget keeps huge logical screens from failing on their allocations.
+ *   clang -g -O1 -fsanitize=fuzzer,address Fuzz.c GIF.c GIF_*.c \
+ *         `sdl-config --cflags --libs`
+ * With -DFUZZ_MAIN, the files given as arguments are run once each, to
+ * replay a crash or a corpus without libFuzzer :
+ *   cc -g -DFUZZ_MAIN -fsanitize=address Fuzz.c GIF.c GIF_*.c \
+ *      `sdl-config --cflags --libs`
+ */
+
+enum {
+  BUDGET = 64 << 20,      /* Bytes */
+  MAXCHUNK = 64
+};
+
+static void appExt(void * data, const GIF_Extension * ext) {
+  Uint16 loops;
+  Uint32 bufsz;
+  
+  (void)data;
+  GIF_GetLoopExt(ext, &loops, &bufsz);
+}
+
+static void fuzzLoad(const Uint8 * data, Uint32 sz, Uint32 flags) {
+  GIF_Surface * gif;
+  GIF_Memory mem;
+  Uint32 i;
+  
+  gif = GIF_LoadGIFMem(data, sz, flags);
+  if (gif == NULL)
+    return;
+  
+  for (i = 0; i < GIF_GetNumFrames(gif); i++)
+    GIF_GetFrame(gif, i);
+  GIF_GetMemory(gif, &mem);
+  GIF_FreeGIF(gif);
+}
+
+static void fuzzDecoder(const Uint8 * data, Uint32 sz, Uint32 chunk) {
+  GIF_Decoder * ctx;
+  Uint32 i, k;
+  
+  ctx = GIF_DecoderCreate(0, NULL, NULL, NULL);
+  if (ctx == NULL)
+    return;
+  GIF_DecoderSetBudget(ctx, BUDGET);
+  
+  for (i = 0; i < sz; i += k) {
+    k = sz - i < chunk ? sz - i : chunk;
+    if (GIF_DecoderPush(ctx, data + i, k) != 0)
+      break;
+  }
+  
+  GIF_DecoderFree(ctx);
+}
+
+int LLVMFuzzerTestOneInput(const Uint8 * data, size_t size) {
+  static int init = 0;
+  Uint8 last;
+  
+  if (size == 0 || size > 0x7FFFFFFF - 65536)
+    return 0;
+  
+  if (!init) {
+    GIF_SetMemoryBudget(BUDGET);
+    GIF_SetExtHandler(GIF_EXT_APP, appExt, NULL);
+    init = 1;
+  }
+  
+  last = data[size - 1];
+  fuzzLoad(data, size, last & 0x80 ? GIF_LOAD_INDEXED | GIF_LOAD_DELTA : 0);
+  fuzzDecoder(data, size, 1 + last % MAXCHUNK);
+  
+  return 0;
+}
+
+
+
+#ifdef FUZZ_MAIN
+
+int main(int argc, char ** argv) {
+  Uint8 * data;
+  FILE * f;
+  long sz;
+  int i;
+  
+  for (i = 1; i < argc; i++) {
+    f = fopen(argv[i], "rb");
+    if (f == NULL) {
+      perror(argv[i]);
+      continue;
+    }
+    fseek(f, 0, SEEK_END);
+    sz = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    
+    data = malloc(sz > 0 ? sz : 1);
+    if (data != NULL && sz > 0 && fread(data, 1, sz, f) == (size_t)sz)
+      LLVMFuzzerTestOneInput(data, sz);
+    
+    free(data);
+    fclose(f);
+    printf("%s\n", argv[i]);
+  }
+  
+  return 0;
+}
+
+#endif
@@ -7,32 +7,11 @@
 
 #include "GIF.h"
 #include "GIF_Struct.h"
-#include "GIF_LZW.h"
-
-enum {
-  NDEFCOLTAB = 256,
-  NBITDEFCOLTAB = 7
-};
-
-GIF_Color defaultColTable[NDEFCOLTAB] = {
-  { 0x00, 0x00, 0x00, 0x00 },
-  { 0xFF, 0xFF, 0xFF, 0x00 }
-};
-
-
-
-struct GIF_Surface_s {
-  SDL_Surface ** images;
-  Uint16 * delays;
-  Uint32 nimg;
-  Uint32 i;
-  
-  Uint32 tnxt;
-
-	Uint16 w;
-	Uint16 h;
-};
-
+#include "GIF_Parse.h"
+#include "GIF_Render.h"
+#include "GIF_Index.h"
+#include "GIF_Decoder.h"
+#include "GIF_Ring.h"
 
 
 
@@ -44,795 +23,681 @@ Uint16 GIF_GetHeight(GIF_Surface *gif) {
 	return gif->h;
 }
 
-
-/* Get nb bytes in s and return it byte ordered */
-unsigned GIF_GetInt(Uint8 * s, int nb) {
-  unsigned n = 0;
-  int i;
+Uint32 GIF_GetNumFrames(GIF_Surface * gif) {
+  Uint32 n;
   
-  for (i = 0; i < nb; i++) {
-    n <<= 8;
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    n |= s[i];
-#elif SDL_BYTEORDER == SDL_LIL_ENDIAN
-    n |= s[nb - i - 1];
-#endif
-  }
+  if (gif->lock != NULL)
+    SDL_LockMutex(gif->lock);
+  n = gif->nimg;
+  if (gif->lock != NULL)
+    SDL_UnlockMutex(gif->lock);
   
   return n;
 }
 
-
-
-
-Sint8 GIF_GetColorTable(GIF_Color ** cols, unsigned n) {
-  unsigned sz;
-  unsigned i;
-  
-  /* 3 x 2^(Size of [Global/Local] Color Table + 1) */
-  sz = 1 << (n + 1);
-  *cols = malloc(sz * sizeof **cols);
-  if (*cols == NULL)
-    return -1;
+int GIF_GetLoadState(GIF_Surface * gif) {
+  int state;
   
-  for (i = 0; i < sz; i++) {
-    (*cols)[i].r = *pdata++;
-    (*cols)[i].g = *pdata++;
-    (*cols)[i].b = *pdata++;
-  }
+  if (gif->lock != NULL)
+    SDL_LockMutex(gif->lock);
+  state = gif->state;
+  if (gif->lock != NULL)
+    SDL_UnlockMutex(gif->lock);
   
-  return 0;
+  return state;
 }
 
 
-/* Header - 6 bytes :
- * -> 3 bytes : signature - "GIF"
- * -> 3 bytes : version - 87A / 89A
- */
-Uint8 GIF_GetHeader(void) {
-  Uint8 vers;
-  
-  if (strncmp((const char*)pdata, "GIF", 3))
-    return GIF_UKNOW;
-  
-  pdata += 3;
-  
-  if (strncmp((const char*)pdata, "87a", 3) == 0)
-    vers = GIF_87A;
-  else if (strncmp((const char*)pdata, "89a", 3) == 0)
-    vers = GIF_89A;
-  else
-    vers = GIF_UKNOW;
-  
-  pdata += 3;
-  
-  return vers;
+enum {
+  GIF_ASYNC_CHUNK = 16384,  /* Bytes read from the file at once */
+  GIF_RING_SLOTS = 8        /* Frames decoded ahead with GIF_LOAD_STREAM */
+};
+
+/* #pragma mark Memory */
+
+/* Bytes a load may use, 0 for no limit */
+static Uint64 memBudget = 0;
+
+void GIF_SetMemoryBudget(Uint64 bytes) {
+  memBudget = bytes;
+}
+
+static Uint64 GIF_SurfaceBytes(Uint16 w, Uint16 h) {
+  return (Uint64)w * h * sizeof(Uint32);
 }
 
-/* Logical Screen Descriptor - 6 bytes :
- * -> 2 bytes : Logical screen width
- * -> 2 bytes : Logical screen height
- * -> 1 byte  : - 1 bit  : global color table flag
- *              - 3 bits : color resolution
- *              - 1 bit  : sort flag
- *              - 3 bits : size of global color table
- * -> 1 byte  : background color index
- * -> 1 byte  : pixel aspect ratio
+/* Peak footprints of the representations of the frames, the decoded
+ * images included. Identical frames are only shared once rendered.
  */
+static Uint64 GIF_FullFootprint(GIF_Raw * raw) {
+  /* A surface per frame not drawn again over the previous one, the canvas
+   * and its copy for disposal method 3
+   */
+  return raw->mem +
+         (GIF_CountSurfaces(raw) + 2) * GIF_SurfaceBytes(raw->w, raw->h);
+}
 
-Sint8 GIF_GetLogScrDescriptor(GIF_Raw * gif) {
-  Uint8 gcolTable;
-  Uint8 szgcolTable;
+static Uint64 GIF_IndexedFootprint(GIF_Raw * raw) {
+  Uint64 n = (Uint64)raw->w * raw->h;
   
-  gif->w = GIF_GetInt(pdata, 2);
-  pdata += 2;
-  
-  gif->h = GIF_GetInt(pdata, 2);
-  pdata += 2;
-  
-  gcolTable = (*pdata) >> 7;
-  szgcolTable = (*pdata) & 0x7;
-  pdata++;
-  
-  gif->bckColIndex = *pdata;
-  pdata++;
-  
-  /* Pixel aspect ratio, skipping... */
-  pdata++;
-  
-  if (gcolTable) {
-    if (GIF_GetColorTable(&gif->gcolTable, szgcolTable) < 0)
-      return -1;
-  }
-  else {
-    gif->gcolTable = defaultColTable;
-  }
-  
-  return 0;
+  /* A plane per frame at worst, the planes of the compositor and of the
+   * presentation, its surface and a palette per frame
+   */
+  return raw->mem + (raw->i + 5) * n + GIF_SurfaceBytes(raw->w, raw->h) +
+         (Uint64)raw->i * 256 * sizeof(Uint32);
 }
 
-/* Image Descriptor - 9 bytes :
- * -> 1 byte  : Image separator - fixed value 0x2C
- * -> 2 bytes : Image left position
- * -> 2 bytes : Image top position
- * -> 2 bytes : Image width
- * -> 2 bytes : Image height
- * -> 1 byte  : - 1 bit  : local color table flag
- *              - 1 bit  : interlace flag
- *              - 1 bit  : sort flag
- *              - 2 bits : reserved
- *              - 3 bits : size of local color table
- */
+static Uint64 GIF_StreamFootprint(Uint16 w, Uint16 h) {
+  /* The ring, the canvas of the decoder and its copy for disposal method 3 */
+  return (GIF_RING_SLOTS + 2) * GIF_SurfaceBytes(w, h);
+}
 
-Sint8 GIF_GetImgDescriptor(GIF_Raw * gif) {
-  GIF_Image * img = &gif->img[gif->i];
-  Uint8 lcolTable;
-  Uint8 szlcolTable;
+/* Bytes held by the frames. While loading in the background, the decoder
+ * isn't counted.
+ */
+void GIF_GetMemory(GIF_Surface * gif, GIF_Memory * mem) {
+  SDL_Surface * sfc;
+  Uint32 i, j;
   
-  img->imgLftPos = GIF_GetInt(pdata, 2);
-  pdata += 2;
+  memset(mem, 0, sizeof *mem);
   
-  img->imgTopPos = GIF_GetInt(pdata, 2);
-  pdata += 2;
+  if (gif->lock != NULL)
+    SDL_LockMutex(gif->lock);
   
-  img->imgWidth = GIF_GetInt(pdata, 2);
-  pdata += 2;
+  mem->total = sizeof *gif;
+  if (gif->delays != NULL)
+    mem->total += gif->cap * sizeof *gif->delays;
   
-  img->imgHeight = GIF_GetInt(pdata, 2);
-  pdata += 2;
+  /* Identical frames share a surface, counted once */
+  if (gif->images != NULL) {
+    mem->total += gif->cap * sizeof *gif->images;
+    for (i = 0; i < gif->nimg; i++) {
+      sfc = gif->images[i];
+      j = i;
+      if (sfc->refcount > 1)
+        while (j > 0 && gif->images[j - 1] != sfc)
+          j--;
+      if (j == 0 || sfc->refcount == 1)
+        mem->frames += (Uint64)sfc->pitch * sfc->h;
+    }
+  }
   
-  lcolTable = ((*pdata) >> 7) & 0x1;
-  img->interlace = ((*pdata) >> 6) & 0x1;
-  szlcolTable = (*pdata) & 0x7;
-  pdata++;
+  if (gif->store != NULL)
+    GIF_Index_Memory(gif->store, mem);
   
-  if (lcolTable) {
-    if (GIF_GetColorTable(&img->lcolTable, szlcolTable) < 0)
-      return -1;
-  }
-  else {
-    img->lcolTable = gif->gcolTable;
-  }
+  /* Every slot, they are allocated with the first frames */
+  if (gif->ring != NULL)
+    mem->frames += GIF_RING_SLOTS * GIF_SurfaceBytes(gif->w, gif->h);
   
-  return 0;
+  if (gif->lock != NULL)
+    SDL_UnlockMutex(gif->lock);
+  
+  mem->total += mem->frames + mem->indexed + mem->palettes;
 }
 
+/* #pragma mark Loading */
 
+static GIF_Surface * GIF_LoadGIFStream(char * s);
 
-/* Extensions */
-/* #pragma mark Extensions */
-
-/* Graphic Control Extension - 7 bytes :
- * -> 1 byte  : Extension introducer - fixed value 0x21
- * -> 1 byte  : Graphic control label - fixed value 0xF9
- * -> 1 byte  : Block size - fixed value 4
- * -> 1 byte  : - 3 bits : reserved
- *              - 3 bits : disposal method
- *              - 1 bit  : user input flag
- *              - 1 bit  : transparent color flag
- * -> 2 bytes : Delay time
- * -> 1 byte  : Transparent color index
- * -> 1 byte  : block terminator - fixed value 0x00
+/* A load that gives no surface : everything it holds is released, 'raw' and
+ * 'gif' can be NULL. Return NULL.
  */
+static GIF_Surface * GIF_LoadFail(Uint8 * p, GIF_Raw * raw, GIF_Surface * gif) {
+  if (raw != NULL)
+    GIF_FreeRaw(raw);
+  GIF_FreeGIF(gif);
+  free(p);
+  
+  return NULL;
+}
 
-Sint8 GIF_GetGraphCtrlExt(GIF_Raw * gif) {
-  if (*pdata++ != 4)
-    return -1;
+static GIF_Surface * GIF_LoadBuffer(Uint8 * p, Sint32 sz, char * s,
+                                    Uint32 flags);
+
+/* Over the memory budget, the frames are kept indexed, then streamed */
+GIF_Surface * GIF_LoadGIFEx(char * s, Uint32 flags) {
+  FILE * f;
+  Sint32 sz;
+  Uint8 * p;
   
-  gif->img[gif->i].dispMeth = ((*pdata) >> 2) & 0x7;
-  gif->img[gif->i].userInput = ((*pdata) >> 1) & 0x1;
-  gif->img[gif->i].transpColor = (*pdata) & 0x1;
-  pdata++;
+  if (flags & GIF_LOAD_STREAM)
+    return GIF_LoadGIFStream(s);
   
-  gif->img[gif->i].delay = GIF_GetInt(pdata, 2);
-  pdata += 2;
+  f = fopen(s, "rb");
+  if (f == NULL)
+    return NULL;
   
-  gif->img[gif->i].transpColorIdx = *pdata;
-  pdata++;
+  fseek(f, 0, SEEK_END);
+  sz = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (sz < 0) {
+    fclose(f);
+    return NULL;
+  }
   
-  /* Skip the block terminator */
-  pdata++;
+  p = malloc((sz + GIF_PAD) * sizeof *p);
+  if (p == NULL) {
+    perror("GIF_LoadGIF: malloc");
+    exit(EXIT_FAILURE);
+  }
   
-  return 0;
+  if (fread(p, sizeof *p, sz, f) != (size_t)sz) {
+    fprintf(stderr, "GIF_LoadGIF: fread: File error.\n");
+    free(p);
+    fclose(f);
+    return NULL;
+  }
+  fclose(f);
+  
+  return GIF_LoadBuffer(p, sz, s, flags);
 }
 
-/* Comment Extension - 3 bytes + N bytes :
- * -> 1 byte  : Extension introducer - fixed value 0x21
- * -> 1 byte  : Comment label - fixed value 0xFE
- * -> 8 bytes : Application identifier
- * -> 3 bytes : App. authentification code
- *
- * -> Data sub-blocks
- *
- * -> 1 byte  : block terminator - fixed value 0x00
- */ 
-
-Sint8 GIF_GetCommExt(void) {
-  Uint32 i, tmp;
-  Uint8 s[256];
-  
-  printf("Comment ext. : ");
-  
-  while (*pdata != 0) {
-    tmp = *pdata;
-    pdata++;
-    
-    for (i = 0; i < tmp; i++)
-      s[i] = pdata[i];
-    s[i] = '\0';
-    
-    printf("%s", s);
-    
-    pdata += tmp;
-  }
+/* From a copy of the file : over the memory budget, the frames can be
+ * indexed but not streamed
+ */
+GIF_Surface * GIF_LoadGIFMem(const Uint8 * data, Uint32 sz, Uint32 flags) {
+  Uint8 * p;
   
-  puts("");
+  if ((flags & GIF_LOAD_STREAM) || sz > 0x7FFFFFFF - GIF_PAD) {
+    fprintf(stderr, "GIF_LoadGIFMem : Can't load from memory.\n");
+    return NULL;
+  }
   
-  /* Skip the block terminator */
-  pdata++;
+  p = malloc((sz + GIF_PAD) * sizeof *p);
+  if (p == NULL) {
+    perror("GIF_LoadGIFMem : malloc");
+    return NULL;
+  }
+  memcpy(p, data, sz);
   
-  return 0;
+  return GIF_LoadBuffer(p, sz, NULL, flags);
 }
 
-/* Application Extension - 14 bytes + N bytes :
- * -> 1 byte  : Extension introducer - fixed value 0x21
- * -> 1 byte  : Comment label - fixed value 0xFF
- * -> 1 byte  : Block size - fixed value 11
- 
- * -> Data sub-blocks
- *
- * -> 1 byte  : block terminator - fixed value 0x00
+/* Parse the 'sz' bytes of 'p', which has room for GIF_PAD more and is
+ * freed. 's' is the file to stream if the frames don't fit in the budget.
  */
-
-Sint8 GIF_GetAppExt(void) {
-  Uint32 i, tmp;
-  Uint8 s[256];
+static GIF_Surface * GIF_LoadBuffer(Uint8 * p, Sint32 sz, char * s,
+                                    Uint32 flags) {
+  GIF_Raw * raw;
+  GIF_Surface * gif;
   
-  if (*pdata++ != 11)
-    return -1;
+  memset(p + sz, 0, GIF_PAD);
+  pdata = p;
+  pend = p + sz;
   
-  for (i = 0; i < 8; i++)
-    s[i] = pdata[i];
-  s[i] = '\0';
-  pdata += 8;
+  /* Null fields : GIF_LoadFail can free them at any step */
+  raw = calloc(1, sizeof *raw);
+  gif = calloc(1, sizeof *gif);
+  if (raw == NULL || gif == NULL)
+    return GIF_LoadFail(p, raw, gif);
   
-  printf("App. identifier : %s\n", s);
+  raw->budget = memBudget;
   
-  for (i = 0; i < 3; i++)
-    s[i] = pdata[i];
-  s[i] = '\0';
-  pdata += 3;
+  raw->version = GIF_GetHeader();
+  if (raw->version != GIF_87A && raw->version != GIF_89A)
+    return GIF_LoadFail(p, raw, gif);
+  
+  if (GIF_GetLogScrDescriptor(raw) < 0)
+    return GIF_LoadFail(p, raw, gif);
   
-  printf("App. auth. code : %s\n", s);
-  printf("App. data : ");
+  if (GIF_GetImages(raw) < 0 && !raw->over)
+    return GIF_LoadFail(p, raw, gif);
   
-  while (*pdata != 0) {
-    tmp = *pdata;
-    pdata++;
+  if (raw->budget != 0 && !raw->over && !(flags & GIF_LOAD_INDEXED) &&
+      GIF_FullFootprint(raw) > raw->budget) {
+    if (flags & GIF_LOAD_NOFALLBACK)
+      raw->over = 1;
+    else
+      flags |= GIF_LOAD_INDEXED | GIF_LOAD_RLE | GIF_LOAD_DELTA;
+  }
+  if (raw->budget != 0 && !raw->over && (flags & GIF_LOAD_INDEXED) &&
+      GIF_IndexedFootprint(raw) > raw->budget)
+    raw->over = 1;
+  
+  gif->store = NULL;
+  if (!raw->over && (flags & GIF_LOAD_INDEXED)) {
+    gif->store = GIF_Index_Render(raw, flags);
     
-    for (i = 0; i < tmp; i++)
-      s[i] = pdata[i];
-    s[i] = '\0';
+    /* More than 256 colors : a surface per frame */
+    if (gif->store == NULL && raw->budget != 0 &&
+        GIF_FullFootprint(raw) > raw->budget)
+      raw->over = 1;
+  }
+  
+  /* Decoded again by the streaming thread, a few frames at a time */
+  if (raw->over) {
+    if (s == NULL || GIF_StreamFootprint(raw->w, raw->h) > raw->budget)
+      flags |= GIF_LOAD_NOFALLBACK;
     
-    printf("%s", s);
+    GIF_LoadFail(p, raw, gif);
     
-    pdata += tmp;
+    if (flags & GIF_LOAD_NOFALLBACK) {
+      fprintf(stderr, "GIF_LoadGIF: Over the memory budget.\n");
+      return NULL;
+    }
+    return GIF_LoadGIFStream(s);
   }
   
-  puts("");
+  if (GIF_InitFrames(raw, gif) < 0 ||
+      (gif->store == NULL && GIF_RenderFrames(raw, gif) < 0))
+    return GIF_LoadFail(p, raw, gif);
   
-  /* Skip the block terminator */
-  pdata++;
+  if (gif->store == NULL && (flags & GIF_LOAD_RLEACCEL))
+    GIF_EncodeFramesRLE(gif);
   
-  return 0;
-}
-
-/* An extension begin with a 0x21 byte */
-
-Sint8 GIF_GetExtension(GIF_Raw * gif) {
   
-  switch (*pdata++) {
-    case 0x01:
-      /* TODO: 25. Plain Text Extension. */
-      break;
-      
-    case 0xF9:
-      return GIF_GetGraphCtrlExt(gif);
-      break;
-      
-    case 0xFE:
-      return GIF_GetCommExt();
-      break;
-      
-    case 0xFF:
-      return GIF_GetAppExt();
-      break;
-      
-    default:
-      fprintf(stderr, "Unknown extension.\n");
-      return -1;
-      break;
-  }
+	gif->w = raw->w;
+	gif->h = raw->h;
   
-  return 0;
-}
-
-/* #pragma mark Images */
-
-/*
- * Set the pixel at (x, y) to the given value
- * NOTE: The surface must be locked before calling this!
- */
-void putpixel(SDL_Surface *surface, int x, int y, Uint32 pixel)
-{
-  int bpp = surface->format->BytesPerPixel;
-  /* Here p is the address to the pixel we want to set */
-  Uint8 *p = (Uint8 *)surface->pixels + y * surface->pitch + x * bpp;
-  
-  switch(bpp) {
-    case 1:
-      *p = pixel;
-      break;
-      
-    case 2:
-      *(Uint16 *)p = pixel;
-      break;
-      
-    case 3:
-      if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
-        p[0] = (pixel >> 16) & 0xff;
-        p[1] = (pixel >> 8) & 0xff;
-        p[2] = pixel & 0xff;
-      } else {
-        p[0] = pixel & 0xff;
-        p[1] = (pixel >> 8) & 0xff;
-        p[2] = (pixel >> 16) & 0xff;
-      }
-      break;
-      
-    case 4:
-      *(Uint32 *)p = pixel;
-      break;
-  }
-}
-
-/*
- * Return the pixel value at (x, y)
- * NOTE: The surface must be locked before calling this!
- */
-Uint32 getpixel(SDL_Surface *surface, int x, int y)
-{
-  int bpp = surface->format->BytesPerPixel;
-  /* Here p is the address to the pixel we want to retrieve */
-  Uint8 *p = (Uint8 *)surface->pixels + y * surface->pitch + x * bpp;
-  
-  switch(bpp) {
-    case 1:
-      return *p;
-      
-    case 2:
-      return *(Uint16 *)p;
-      
-    case 3:
-      if(SDL_BYTEORDER == SDL_BIG_ENDIAN)
-        return p[0] << 16 | p[1] << 8 | p[2];
-      else
-        return p[0] | p[1] << 8 | p[2] << 16;
-      
-    case 4:
-      return *(Uint32 *)p;
-      
-    default:
-      return 0;       /* shouldn't happen, but avoid warnings */
-  }
+  gif->thread = NULL;
+  gif->lock = NULL;
+  gif->ring = NULL;
+  gif->cap = gif->nimg;
+  gif->state = GIF_LOADED;
+  gif->cancel = 0;
+  gif->file = NULL;
+  gif->done = NULL;
+  gif->data = NULL;
+  gif->budget = raw->budget;
+  gif->mem = 0;
+  gif->over = 0;
+  gif->failed = 0;
+  
+  GIF_FreeRaw(raw);
+  free(p);
+  
+  return gif;
 }
 
-
-void GIF_InitImage(GIF_Raw * gif, GIF_Image * img) {
-  img->delay = 0;
-  img->dispMeth = 0;
-  img->imgHeight = gif->h;
-  img->imgWidth = gif->w;
-  img->imgLftPos = 0;
-  img->imgTopPos = 0;
-  img->interlace = 0;
-  img->transpColor = 0;
-  img->userInput = 0;
-  img->lcolTable = gif->gcolTable;
+GIF_Surface * GIF_LoadGIF(char * s) {
+  return GIF_LoadGIFEx(s, 0);
 }
 
-/* Get 1 image */
+/* #pragma mark Asynchronous loading */
 
-Sint8 GIF_GetImage(GIF_Raw * gif) {
-  GIF_Image * img;
-  
-  img = realloc(gif->img, (gif->i + 1) * sizeof *gif->img);
-  if (img == NULL)
-    return -1;
-  gif->img = img;
-  
-  img = &gif->img[gif->i];
-  
-  GIF_InitImage(gif, img);
-  
-  while (1) {
-    
-    switch (*pdata++) {
-        /* Extensions */
-      case 0x21:
-        if (GIF_GetExtension(gif) < 0)
-          return -1;
-        break;
-        
-        /* Image */
-      case 0x2C:
-        if (GIF_GetImgDescriptor(gif) < 0)
-          return -1;
-        
-        if (GIF_LZW_GetData(img) < 0)
-          return -1;
-        
-        return 0;
-        break;
-        
-        /* Trailer */
-      case 0x3B:
-        return 1;
-        break;
-      
-      default:
-        fprintf(stderr, "GIF_GetImage: Unknown code.\n");
-        return -1;
-        break;
-    }
-  }
+static void GIF_CopyCanvas(SDL_Surface * dst, SDL_Surface * canvas) {
+  Uint32 i;
   
+  if (SDL_MUSTLOCK(canvas))
+    SDL_LockSurface(canvas);
+  for (i = 0; i < (Uint32)canvas->h; i++)
+    memcpy((Uint8 *)dst->pixels + i * dst->pitch,
+           (Uint8 *)canvas->pixels + i * canvas->pitch,
+           canvas->w * canvas->format->BytesPerPixel);
+  if (SDL_MUSTLOCK(canvas))
+    SDL_UnlockSurface(canvas);
   
-  return 0;
+  SDL_SetColorKey(dst, GIF_COLORKEY, GIF_TRANSPARENT);
 }
 
-/* Get all the images */
-
-Sint8 GIF_GetImages(GIF_Raw * gif) {
-  Sint8 tmp;
+/* Decoder callback : keep a copy of the composited frame */
+static void GIF_AsyncFrame(void * data, SDL_Surface * canvas,
+                           Uint32 frame, Uint16 delay) {
+  GIF_Surface * gif = data;
+  SDL_Surface * sfc = NULL;
+  SDL_Surface * prev = NULL;
+  SDL_Surface ** images;
+  Uint16 * delays;
+  Uint64 bytes;
   
-  gif->img = NULL;
-  gif->i = 0;
+  (void)frame;
   
-  while (1) {
-    tmp = GIF_GetImage(gif);
-    
-    if (tmp < 0) {
-      fprintf(stderr, "GIF_GetImages: Frame error.\n");
-      return -1;
+  /* Frames are only appended by this thread, no need to lock to read them */
+  if (gif->nimg > 0)
+    prev = gif->images[gif->nimg - 1];
+  
+  if (prev != NULL && GIF_SameSurface(prev, canvas)) {
+    sfc = prev;
+  }
+  else {
+    /* The canvas of the decoder and its copy are in the budget too */
+    bytes = GIF_SurfaceBytes(canvas->w, canvas->h);
+    if (gif->budget != 0 && gif->mem + 3 * bytes > gif->budget) {
+      gif->over = 1;
+      return;
     }
-    else if (tmp == 1)
-      break;
     
-    gif->i++;
+    sfc = GIF_CreateRGBSurface(canvas->w, canvas->h);
+    if (sfc == NULL) {
+      gif->failed = 1;
+      return;
+    }
+    GIF_CopyCanvas(sfc, canvas);
+    gif->mem += bytes;
   }
   
-  return 0;
-}
-
-SDL_Surface * GIF_CreateRGBSurface(Uint16 w, Uint16 h) {
-  SDL_Surface * tmp;
-  SDL_Surface * sfc;
-  
-  tmp = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 32, 0, 0, 0, 0);
-  if (tmp == NULL)
-    return NULL;
-  
-  sfc = SDL_DisplayFormat(tmp);
-  SDL_FreeSurface(tmp);
-  
-  return sfc;
-}
-
-int GIF_BlitDispMethod1(SDL_Surface * dst, GIF_Image * img) {
-  Uint32 x, y;
-  Uint32 k, l;
-  Uint32 h, w;
-  Uint32 tmp;
-  Uint32 col;
-  
-  h = img->imgHeight;
-  w = img->imgWidth;
-  
-  if (SDL_MUSTLOCK(dst))
-    SDL_LockSurface(dst);
-  
-  for (k = 0, y = img->imgTopPos; k < h; y++, k++) {
-    for (l = 0, x = img->imgLftPos; l < w; x++, l++) {
-      tmp = (k * w) + l;
-            
-      if (!img->transpColor ||
-          (img->transpColor && img->data[tmp] != img->transpColorIdx)) {
-        col = SDL_MapRGB(dst->format,
-                         img->lcolTable[img->data[tmp]].r,
-                         img->lcolTable[img->data[tmp]].g,
-                         img->lcolTable[img->data[tmp]].b);
-        
-        putpixel(dst, x, y, col);
-      }
+  SDL_LockMutex(gif->lock);
+  
+  if (gif->nimg == gif->cap) {
+    gif->cap = gif->cap == 0 ? 16 : gif->cap * 2;
+    images = realloc(gif->images, gif->cap * sizeof *images);
+    delays = realloc(gif->delays, gif->cap * sizeof *delays);
+    if (images != NULL)
+      gif->images = images;
+    if (delays != NULL)
+      gif->delays = delays;
+    if (images == NULL || delays == NULL) {
+      gif->cap = gif->nimg;
+      gif->failed = 1;
+      SDL_UnlockMutex(gif->lock);
+      if (sfc != prev)
+        SDL_FreeSurface(sfc);
+      return;
     }
   }
   
-  if (SDL_MUSTLOCK(dst))
-    SDL_UnlockSurface(dst);
+  /* GIF_GetMemory reads the counts under the lock */
+  if (sfc == prev)
+    sfc->refcount++;
+  gif->images[gif->nimg] = sfc;
+  gif->delays[gif->nimg] = delay;
+  gif->nimg++;
+  
+  /* Frame 0 is shown for its own delay from now on */
+  if (gif->nimg == 1) {
+    gif->w = canvas->w;
+    gif->h = canvas->h;
+    gif->tnxt = SDL_GetTicks() + delay * 10;
+  }
   
-  return 0;
+  SDL_UnlockMutex(gif->lock);
 }
 
-int GIF_BlitDispMethod2(SDL_Surface * dst, SDL_Rect * r, Uint32 color) {
-  Uint32 x, y;
-  Uint32 k, l;
-  
-  k = r->y + r->h;
-  l = r->x + r->w;
-  
-  if (SDL_MUSTLOCK(dst))
-    SDL_LockSurface(dst);
+/* Decoder callback with GIF_LOAD_STREAM : copy the frame into the ring,
+ * waiting for the player to free a slot.
+ */
+static void GIF_StreamFrame(void * data, SDL_Surface * canvas,
+                            Uint32 frame, Uint16 delay) {
+  GIF_Surface * gif = data;
+  GIF_RingSlot * slot;
+  Uint8 cancel;
+  
+  while (GIF_Ring_Full(gif->ring)) {
+    SDL_LockMutex(gif->lock);
+    cancel = gif->cancel;
+    SDL_UnlockMutex(gif->lock);
+    if (cancel)
+      return;
+    SDL_Delay(1);
+  }
   
-  for (y = r->y; y < k; y++) {
-    for (x = r->x; x < l; x++) {
-      putpixel(dst, x, y, color);
+  slot = GIF_Ring_Back(gif->ring);
+  if (slot->sfc != NULL &&
+      (slot->sfc->w != canvas->w || slot->sfc->h != canvas->h)) {
+    SDL_FreeSurface(slot->sfc);
+    slot->sfc = NULL;
+  }
+  if (slot->sfc == NULL) {
+    if (gif->budget != 0 &&
+        GIF_StreamFootprint(canvas->w, canvas->h) > gif->budget) {
+      gif->over = 1;
+      return;
+    }
+    slot->sfc = GIF_CreateRGBSurface(canvas->w, canvas->h);
+    if (slot->sfc == NULL) {
+      gif->failed = 1;
+      return;
     }
   }
   
-  if (SDL_MUSTLOCK(dst))
-    SDL_UnlockSurface(dst);
+  GIF_CopyCanvas(slot->sfc, canvas);
+  slot->delay = delay;
+  slot->frame = frame;
+  
+  /* The frames are counted during the first pass only */
+  if (gif->state == GIF_LOADING) {
+    SDL_LockMutex(gif->lock);
+    gif->nimg = frame + 1;
+    gif->w = canvas->w;
+    gif->h = canvas->h;
+    SDL_UnlockMutex(gif->lock);
+  }
   
-  return 0;
+  GIF_Ring_Push(gif->ring);
 }
 
-int GIF_BlitDispMethod3(SDL_Surface * src, SDL_Surface * dst, SDL_Rect * r) {
-  Uint32 x, y;
-  Uint32 k, l;
-  
-  k = r->y + r->h;
-  l = r->x + r->w;
-  
-  if (SDL_MUSTLOCK(src))
-    SDL_LockSurface(src);
-  if (SDL_MUSTLOCK(dst))
-    SDL_LockSurface(dst);
-  
-  for (y = r->y; y < k; y++) {
-    for (x = r->x; x < l; x++) {
-      putpixel(dst, x, y, getpixel(src, x, y));
-    }
-  }
-  
-  if (SDL_MUSTLOCK(src))
-    SDL_UnlockSurface(src);
-  if (SDL_MUSTLOCK(dst))
-    SDL_UnlockSurface(dst);
+/* Set the final state of the first pass and tell the caller */
+static void GIF_AsyncDone(GIF_Surface * gif, int ret) {
+  SDL_LockMutex(gif->lock);
+  gif->state = ret == 1 ? GIF_LOADED : GIF_FAILED;
+  SDL_UnlockMutex(gif->lock);
   
-  return 0;
+  if (gif->done != NULL)
+    gif->done(gif->data, gif, ret == 1 ? 0 : -1);
 }
 
-Sint8 GIF_RenderInterlace(GIF_Image * img, SDL_Surface * dst) {
-  Uint8 start[4] = { 0, 4, 2, 1 };
-  Uint8 off[4] = { 8, 8, 4, 2 };
-  Uint32 i, j, k, l;
-  Uint32 tmp;
-  Uint32 col;
-  
-  if (SDL_MUSTLOCK(dst))
-    SDL_LockSurface(dst);
-  
-  l = 0;
-  for (k = 0; k < 4; k++) {
-    for (i = start[k]; i < img->imgHeight; i += off[k]) {
-      for (j = 0; j < img->imgWidth; j++) {
-        tmp = (l * img->imgWidth) + j;
-        
-        col = SDL_MapRGB(dst->format,
-                         img->lcolTable[img->data[tmp]].r,
-                         img->lcolTable[img->data[tmp]].g,
-                         img->lcolTable[img->data[tmp]].b);
-        
-        putpixel(dst, j, i, col);
+static int GIF_AsyncThread(void * data) {
+  GIF_Surface * gif = data;
+  GIF_Decoder * ctx;
+  Uint8 * buf;
+  FILE * f;
+  size_t n;
+  int ret = -1;
+  Uint8 cancel = 0;
+  
+  ctx = GIF_DecoderCreate(0, gif->ring != NULL ? GIF_StreamFrame :
+                          GIF_AsyncFrame, NULL, gif);
+  if (ctx != NULL)
+    GIF_DecoderSetBudget(ctx, gif->budget);
+  buf = malloc(GIF_ASYNC_CHUNK);
+  f = fopen(gif->file, "rb");
+  
+  if (ctx != NULL && buf != NULL && f != NULL) {
+    ret = 0;
+    while (ret == 0 && !cancel) {
+      n = fread(buf, 1, GIF_ASYNC_CHUNK, f);
+      if (n == 0) {
+        fprintf(stderr, "GIF_LoadGIFAsync: Unexpected end of file.\n");
+        ret = -1;
+        break;
+      }
+      ret = GIF_DecoderPush(ctx, buf, n);
+      if (gif->over) {
+        fprintf(stderr, "GIF_LoadGIFAsync: Over the memory budget.\n");
+        ret = -1;
+        break;
+      }
+      if (gif->failed) {
+        fprintf(stderr, "GIF_LoadGIFAsync: A frame couldn't be kept.\n");
+        ret = -1;
+        break;
+      }
+      
+      /* Streaming : decode the file again when it ends, the first frames
+       * are played back while the last ones are still in the ring.
+       */
+      if (ret == 1 && gif->ring != NULL) {
+        if (gif->state == GIF_LOADING)
+          GIF_AsyncDone(gif, ret);
+        if (gif->nimg > 1) {
+          rewind(f);
+          GIF_DecoderReset(ctx);
+          ret = 0;
+        }
       }
-      l++;
+      
+      SDL_LockMutex(gif->lock);
+      cancel = gif->cancel;
+      SDL_UnlockMutex(gif->lock);
     }
   }
   
-  if (SDL_MUSTLOCK(dst))
-    SDL_UnlockSurface(dst);
+  if (f != NULL)
+    fclose(f);
+  free(buf);
+  if (ctx != NULL)
+    GIF_DecoderFree(ctx);
+  
+  if (gif->state == GIF_LOADING && !cancel)
+    GIF_AsyncDone(gif, ret);
   
   return 0;
 }
 
-/* Put all the raw images in an array of SDL_Surface */
-
-Sint8 GIF_RenderFrames(GIF_Raw * raw, GIF_Surface * gif) {
-  SDL_Surface * sfc;
-  SDL_Rect r;
-  Uint32 col;
-  Uint32 i, j;
-  Uint32 alpha;
-  
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-  alpha = 0xFF000000;
-#elif SDL_BYTEORDER == SDL_LIL_ENDIAN
-  alpha = 0x000000FF;
-#endif
-  
-  sfc = GIF_CreateRGBSurface(raw->w, raw->h);
-  if (sfc == NULL)
-    return -1;
+/* Start the decoding thread, the frames go to 'images' or to the ring */
+static GIF_Surface * GIF_StartThread(char * s, GIF_LoadFunc done,
+                                     void * data, Uint32 nslots) {
+  GIF_Surface * gif;
   
-  SDL_FillRect(sfc, NULL, alpha);
-  SDL_SetColorKey(sfc, SDL_SRCCOLORKEY, alpha);
+  gif = calloc(1, sizeof *gif);
+  if (gif == NULL)
+    return NULL;
   
-  for (i = 0; i < gif->nimg; i++) {
-    if (raw->img[i].interlace)
-      GIF_RenderInterlace(&raw->img[i], gif->images[i]);
-    else
-      GIF_BlitDispMethod1(sfc, &raw->img[i]);
-    
-    SDL_BlitSurface(sfc, NULL, gif->images[i], NULL);
-    
-//    {
-//      SDL_Surface * screen = SDL_GetVideoSurface();
-//      
-//      SDL_FillRect(screen, NULL, 0xFF00FF00);
-//      SDL_BlitSurface(gif->images[i], NULL, screen, NULL);
-//      SDL_Flip(screen);
-//      SDL_Delay(1000);
-//      
-//      
-//    }
-    
-    switch (raw->img[i].dispMeth) {
-      case 0:
-      case 1:
-      default:
-        break;
-        
-      case 2:
-        r.x = raw->img[i].imgLftPos;
-        r.y = raw->img[i].imgTopPos;
-        r.w = raw->img[i].imgWidth;
-        r.h = raw->img[i].imgHeight;
-        col = alpha;
-        
-        GIF_BlitDispMethod2(sfc, &r, col);
-        break;
-        
-      case 3:
-        r.x = raw->img[i].imgLftPos;
-        r.y = raw->img[i].imgTopPos;
-        r.w = raw->img[i].imgWidth;
-        r.h = raw->img[i].imgHeight;
-        
-        if (i == 0)
-          break;
-        
-        j = i;
-        while (j > 0 && raw->img[j - 1].dispMeth == 3)
-          j--;
-        
-        GIF_BlitDispMethod3(gif->images[j - 1], sfc, &r);
-        break;
-    }
-    
+  gif->state = GIF_LOADING;
+  gif->done = done;
+  gif->data = data;
+  gif->budget = memBudget;
+  
+  gif->file = malloc(strlen(s) + 1);
+  gif->lock = SDL_CreateMutex();
+  if (nslots > 0)
+    gif->ring = GIF_Ring_Create(nslots);
+  if (gif->file == NULL || gif->lock == NULL ||
+      (nslots > 0 && gif->ring == NULL)) {
+    GIF_FreeGIF(gif);
+    return NULL;
   }
+  strcpy(gif->file, s);
   
-  SDL_FreeSurface(sfc);
+  gif->thread = GIF_CreateThread(GIF_AsyncThread, "GIF_Load", gif);
+  if (gif->thread == NULL) {
+    fprintf(stderr, "GIF_LoadGIFAsync: SDL_CreateThread: %s\n",
+            SDL_GetError());
+    GIF_FreeGIF(gif);
+    return NULL;
+  }
   
-  return 0;
+  return gif;
 }
 
-Sint8 GIF_InitFrames(GIF_Raw * raw, GIF_Surface * gif) {
-  Uint32 i;
-  Uint32 alpha;
-  
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-  alpha = 0xFF000000;
-#elif SDL_BYTEORDER == SDL_LIL_ENDIAN
-  alpha = 0x000000FF;
-#endif
-  
-  gif->i = 0;
-  gif->tnxt = 0;
-  gif->nimg = raw->i;
-  
-  gif->images = malloc(gif->nimg * sizeof *gif->images);
-  if (gif->images == NULL)
-    return -1;
-  
-  gif->delays = malloc(gif->nimg * sizeof *gif->delays);
-  if (gif->delays == NULL)
-    return -1;
-  
-  for (i = 0; i < gif->nimg; i++) {
-    gif->images[i] = GIF_CreateRGBSurface(raw->w, raw->h);
-    if (gif->images[i] == NULL)
-      return -1;
-    
-    gif->delays[i] = raw->img[i].delay;
-    
-    SDL_FillRect(gif->images[i], NULL, alpha);
-    SDL_SetColorKey(gif->images[i], SDL_SRCCOLORKEY, alpha);
-  }
-  
-  return 0;
+/* Return at once, the frames are decoded by a background thread.
+ * GIF_GetNextFrame returns NULL until frame 0 is available.
+ */
+GIF_Surface * GIF_LoadGIFAsync(char * s, GIF_LoadFunc done, void * data) {
+  return GIF_StartThread(s, done, data, 0);
 }
 
-GIF_Surface * GIF_LoadGIF(char * s) {
-  GIF_Raw * raw;
+/* GIF_LOAD_STREAM : only GIF_RING_SLOTS frames are kept, the thread decodes
+ * ahead of the playback and starts over at the end of the file.
+ * Wait for the first frame so that the size is known.
+ */
+static GIF_Surface * GIF_LoadGIFStream(char * s) {
   GIF_Surface * gif;
-  FILE * f;
-  Sint32 sz;
-  Uint8 * p;
   
-  f = fopen(s, "rb");
-  if (f == NULL)
+  gif = GIF_StartThread(s, NULL, NULL, GIF_RING_SLOTS);
+  if (gif == NULL)
     return NULL;
   
-  fseek(f, 0, SEEK_END);
-  sz = ftell(f);
-  fseek(f, 0, SEEK_SET);
+  while (GIF_Ring_Count(gif->ring) == 0 &&
+         GIF_GetLoadState(gif) == GIF_LOADING)
+    SDL_Delay(1);
   
-  p = malloc(sz * sizeof *p);
-  if (p == NULL) {
-    perror("GIF_LoadGIF: malloc");
-    exit(EXIT_FAILURE);
-  }
-  
-  if (fread(p, sizeof *p, sz, f) != (size_t)sz) {
-    fprintf(stderr, "GIF_LoadGIF: fread: File error.\n");
+  /* Failed, or a file without any image */
+  if (GIF_Ring_Count(gif->ring) == 0) {
+    GIF_FreeGIF(gif);
     return NULL;
   }
   
-  pdata = p;
-  
-  raw = malloc(sizeof *raw);
-  if (raw == NULL)
-    return NULL;
+  return gif;
+}
+
+/* Stop the loading thread if needed and free everything */
+void GIF_FreeGIF(GIF_Surface * gif) {
+  Uint32 i;
   
-  gif = malloc(sizeof *gif);
   if (gif == NULL)
-    return NULL;
+    return;
   
-  raw->version = GIF_GetHeader();
-  if (raw->version != GIF_87A && raw->version != GIF_89A)
-    return NULL;
+  if (gif->thread != NULL) {
+    SDL_LockMutex(gif->lock);
+    gif->cancel = 1;
+    SDL_UnlockMutex(gif->lock);
+    SDL_WaitThread(gif->thread, NULL);
+  }
   
-  if (GIF_GetLogScrDescriptor(raw) < 0)
-    return NULL;
+  if (gif->images != NULL)
+    for (i = 0; i < gif->nimg; i++)
+      SDL_FreeSurface(gif->images[i]);
+  free(gif->images);
+  free(gif->delays);
+  
+  if (gif->store != NULL)
+    GIF_Index_Free(gif->store);
+  if (gif->ring != NULL)
+    GIF_Ring_Free(gif->ring);
+  if (gif->lock != NULL)
+    SDL_DestroyMutex(gif->lock);
+  free(gif->file);
+  free(gif);
+}
+
+/* Playback from the ring, without locking : the front slot is on screen */
+static SDL_Surface * GIF_GetNextStreamFrame(GIF_Surface * gif) {
+  Uint32 curr = SDL_GetTicks();
+  GIF_RingSlot * slot;
   
-  if (GIF_GetImages(raw) < 0)
+  slot = GIF_Ring_Front(gif->ring);
+  if (slot == NULL)
     return NULL;
   
+  if (gif->tnxt == 0)
+    gif->tnxt = curr + slot->delay * 10;
   
+  /* Stay on the front frame until the next one is decoded */
+  if (curr > gif->tnxt && GIF_Ring_Count(gif->ring) >= 2) {
+    GIF_Ring_Pop(gif->ring);
+    slot = GIF_Ring_Front(gif->ring);
+    gif->i = slot->frame;
+    gif->tnxt = SDL_GetTicks() + slot->delay * 10;
+  }
   
+  return slot->sfc;
+}
+
+/* Frame i without moving the playback, NULL with GIF_LOAD_STREAM or if it
+ * isn't there yet. An indexed frame is only valid until the next call.
+ */
+SDL_Surface * GIF_GetFrame(GIF_Surface * gif, Uint32 i) {
+  SDL_Surface * sfc = NULL;
   
-  
-  if (GIF_InitFrames(raw, gif) < 0)
+  if (gif->ring != NULL)
     return NULL;
   
-  if (GIF_RenderFrames(raw, gif) < 0)
-    return NULL;
+  if (gif->lock != NULL)
+    SDL_LockMutex(gif->lock);
   
-
-	gif->w = raw->w;
-	gif->h = raw->h;
+  if (i < gif->nimg) {
+    if (gif->store != NULL)
+      sfc = GIF_Index_GetFrame(gif->store, i);
+    else
+      sfc = gif->images[i];
+  }
   
+  if (gif->lock != NULL)
+    SDL_UnlockMutex(gif->lock);
   
-  free(p);
-  fclose(f);
-  
-  return gif;
+  return sfc;
 }
 
 SDL_Surface * GIF_GetNextFrame(GIF_Surface * gif) {
   Uint32 curr = SDL_GetTicks();
+  SDL_Surface * sfc;
+  
+  if (gif->ring != NULL)
+    return GIF_GetNextStreamFrame(gif);
+  
+  if (gif->lock != NULL)
+    SDL_LockMutex(gif->lock);
   
-  if (curr > gif->tnxt) {
+  if (gif->nimg == 0) {
+    if (gif->lock != NULL)
+      SDL_UnlockMutex(gif->lock);
+    return NULL;
+  }
+  
+  /* While loading, stay on the last frame received */
+  if (curr > gif->tnxt &&
+      (gif->i + 1 < gif->nimg || gif->state != GIF_LOADING)) {
     gif->i++;
     
     if (gif->i >= gif->nimg)
@@ -841,8 +706,15 @@ SDL_Surface * GIF_GetNextFrame(GIF_Surface * gif) {
     gif->tnxt = SDL_GetTicks() + (gif->delays[gif->i] * 10);
   }
   
+  if (gif->store != NULL)
+    sfc = GIF_Index_GetFrame(gif->store, gif->i);
+  else
+    sfc = gif->images[gif->i];
+  
+  if (gif->lock != NULL)
+    SDL_UnlockMutex(gif->lock);
   
-  return gif->images[gif->i];
+  return sfc;
 }
 
 
@@ -3,11 +3,75 @@
 
 typedef struct GIF_Surface_s GIF_Surface;
 
+/* Flags for GIF_LoadGIFEx */
+enum {
+  GIF_LOAD_INDEXED = 0x01,  /* Keep the frames as 8-bit index planes */
+  GIF_LOAD_RLE = 0x02,      /* Run-length encode the index planes */
+  GIF_LOAD_DELTA = 0x04,    /* Encode each index plane against the previous one */
+  GIF_LOAD_STREAM = 0x08,   /* Decode while playing, few frames in memory */
+  GIF_LOAD_RLEACCEL = 0x10, /* RLE blits for the mostly transparent frames */
+  GIF_LOAD_NOFALLBACK = 0x20  /* Fail rather than index or stream the frames
+                                 when they don't fit in the memory budget */
+};
+
+/* Load states */
+enum {
+  GIF_LOADING,              /* Frames are still being decoded */
+  GIF_LOADED,               /* Every frame is available */
+  GIF_FAILED                /* Decoding stopped, the frames received are kept */
+};
+
+/* Called from the loading thread when it ends, 'status' is 0 or -1 */
+typedef void (*GIF_LoadFunc)(void * data, GIF_Surface * gif, int status);
+
+/* Extension labels */
+enum {
+  GIF_EXT_PLAINTEXT = 0x01,
+  GIF_EXT_GRAPHCTRL = 0xF9, /* Always read by the library, no handler */
+  GIF_EXT_COMMENT = 0xFE,
+  GIF_EXT_APP = 0xFF
+};
+
+/* An extension as it is in the file : its sub-blocks, each one is its size
+ * then its bytes. Only valid during the call to the handler.
+ */
+typedef struct {
+  Uint8 label;
+  const Uint8 * data;
+  Uint32 size;              /* Bytes of the sub-blocks, terminator excluded */
+} GIF_Extension;
+
+/* Called while loading, from the thread that reads the file */
+typedef void (*GIF_ExtFunc)(void * data, const GIF_Extension * ext);
+
+/* Memory held by a GIF_Surface (bytes) */
+typedef struct {
+  Uint64 frames;            /* Pixels of the composited surfaces */
+  Uint64 indexed;           /* Index planes with GIF_LOAD_INDEXED */
+  Uint64 palettes;          /* Color tables kept for the index planes */
+  Uint64 total;             /* The above and the frame tables */
+} GIF_Memory;
+
 GIF_Surface * GIF_LoadGIF(char * file);
+GIF_Surface * GIF_LoadGIFEx(char * file, Uint32 flags);
+GIF_Surface * GIF_LoadGIFMem(const Uint8 * data, Uint32 sz, Uint32 flags);
+GIF_Surface * GIF_LoadGIFAsync(char * file, GIF_LoadFunc done, void * data);
 SDL_Surface * GIF_GetNextFrame(GIF_Surface * gif);
+SDL_Surface * GIF_GetFrame(GIF_Surface * gif, Uint32 i);
+void GIF_FreeGIF(GIF_Surface * gif);
 
 Uint16 GIF_GetWidth(GIF_Surface *gif);
 Uint16 GIF_GetHeight(GIF_Surface *gif);
+Uint32 GIF_GetNumFrames(GIF_Surface * gif);
+int GIF_GetLoadState(GIF_Surface * gif);
+
+void GIF_SetMemoryBudget(Uint64 bytes);
+void GIF_GetMemory(GIF_Surface * gif, GIF_Memory * mem);
+
+void GIF_SetExtHandler(Uint8 label, GIF_ExtFunc f, void * data);
+const Uint8 * GIF_ExtSubBlock(const GIF_Extension * ext, const Uint8 * pos,
+                              Uint8 * len);
+int GIF_GetLoopExt(const GIF_Extension * ext, Uint16 * loops, Uint32 * bufsz);
 
 #endif
 
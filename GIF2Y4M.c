@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Video.h"
+
+
+/* GIF2Y4M [-rgba] [-r fps] file.gif [out]
+ * Write the animation as a Y4M (or raw RGBA) stream, to stdout by default :
+ *   GIF2Y4M anim.gif | ffmpeg -i - anim.mp4
+ */
+
+enum {
+  SDL_FLAGS = SDL_INIT_VIDEO,
+  DEFAULT_FPS = 25
+};
+
+
+
+Sint32 init(void) {
+  /* No window is opened, the canvases don't depend on the display */
+  if (getenv("SDL_VIDEODRIVER") == NULL)
+    putenv("SDL_VIDEODRIVER=dummy");
+  
+  if (SDL_Init(SDL_FLAGS) < 0) {
+    fprintf(stderr, "SDL_Init : %s\n", SDL_GetError());
+    return -1;
+  }
+  atexit(SDL_Quit);
+  
+  return 0;
+}
+
+void usage(char * name) {
+  fprintf(stderr, "usage : %s [-rgba] [-r fps] file.gif [out]\n", name);
+}
+
+int main(int argc, char ** argv) {
+  Uint32 format = GIF_VIDEO_Y4M;
+  int fps = DEFAULT_FPS;
+  char * in = NULL;
+  char * name = NULL;
+  FILE * out;
+  int i, n;
+  
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-rgba") == 0)
+      format = GIF_VIDEO_RGBA;
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+      fps = atoi(argv[++i]);
+    else if (in == NULL)
+      in = argv[i];
+    else if (name == NULL)
+      name = argv[i];
+    else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  
+  if (in == NULL || fps <= 0 || fps > 0xFFFF) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  
+  if (init() < 0)
+    return EXIT_FAILURE;
+  
+  out = name == NULL || strcmp(name, "-") == 0 ? stdout : fopen(name, "wb");
+  if (out == NULL) {
+    perror("fopen");
+    return EXIT_FAILURE;
+  }
+  
+  n = GIF_WriteVideo(in, out, format, fps);
+  if (out != stdout)
+    fclose(out);
+  
+  if (n < 0) {
+    fprintf(stderr, "Error: main: Conversion failed !\n");
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "%d frames at %d fps\n", n, fps);
+  
+  return EXIT_SUCCESS;
+}
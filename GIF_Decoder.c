@@ -0,0 +1,635 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Struct.h"
+#include "GIF_Parse.h"
+#include "GIF_LZW.h"
+#include "GIF_Render.h"
+#include "GIF_Decoder.h"
+
+
+enum {
+  GIF_DECODER_BUFSZ = 1024    /* Largest block : descriptor + color table */
+};
+
+/* What the decoder is waiting for */
+enum {
+  GIF_STATE_HEADER,       /* Header, logical screen descriptor, color table */
+  GIF_STATE_BLOCK,        /* Block introducer */
+  GIF_STATE_EXTLABEL,     /* Extension label */
+  GIF_STATE_GRAPHCTRL,    /* Graphic control extension */
+  GIF_STATE_SKIPLEN,      /* Length of a sub-block to skip */
+  GIF_STATE_SKIPDATA,     /* Content of a sub-block to skip */
+  GIF_STATE_IMAGE,        /* Image descriptor and color table */
+  GIF_STATE_MINCODE,      /* LZW minimum code size */
+  GIF_STATE_DATALEN,      /* Length of an image data sub-block */
+  GIF_STATE_DATA,         /* Content of an image data sub-block */
+  GIF_STATE_DONE,
+  GIF_STATE_ERROR
+};
+
+struct GIF_Decoder_s {
+  Uint32 flags;
+  GIF_FrameFunc frame;
+  GIF_RowFunc row;
+  void * data;
+  
+  Uint8 state;
+  Uint8 stop;                   /* Set by GIF_DecoderStop */
+  Uint8 buf[GIF_DECODER_BUFSZ]; /* Block split between two pushes */
+  Uint32 len;                   /* Bytes in 'buf' */
+  Uint32 left;                  /* Bytes left in the current sub-block */
+  
+  Uint8 label;                  /* Extension being read */
+  Uint8 keep;                   /* It has a handler, its sub-blocks are kept */
+  Uint8 * ext;                  /* Sub-blocks of the extension */
+  Uint32 extLen;
+  Uint32 extCap;
+  
+  GIF_Raw raw;                  /* Logical screen */
+  GIF_Image img;                /* Current image */
+  GIF_LZW_Stream * lzw;
+  Uint8 lzwDone;
+  Uint32 n;                     /* Number of the current frame */
+  
+  Uint8 pass;                   /* Interlace pass */
+  Uint16 y;                     /* Next row of the image */
+  
+  SDL_Surface * canvas;
+  SDL_Surface * save;           /* Canvas saved for disposal method 3 */
+  GIF_Palette gpal;             /* Global table, canvas format */
+  GIF_Palette lpal;             /* Local table of the image */
+  const Uint32 * lut;           /* Colors of the image */
+  Uint32 alpha;
+  SDL_Rect dispRect;            /* Previous image, disposed before the next */
+  Uint8 dispMeth;
+};
+
+
+
+GIF_Decoder * GIF_DecoderCreate(Uint32 flags, GIF_FrameFunc frame,
+                                GIF_RowFunc row, void * data) {
+  GIF_Decoder * ctx;
+  
+  ctx = calloc(1, sizeof *ctx);
+  if (ctx == NULL) {
+    perror("GIF_DecoderCreate : calloc");
+    return NULL;
+  }
+  
+  ctx->lzw = GIF_LZW_StreamCreate();
+  if (ctx->lzw == NULL) {
+    free(ctx);
+    return NULL;
+  }
+  
+  ctx->flags = flags;
+  ctx->frame = frame;
+  ctx->row = row;
+  ctx->data = data;
+  ctx->raw.gcolTable = defaultColTable;
+  
+  ctx->alpha = GIF_TRANSPARENT;
+  
+  GIF_DecoderReset(ctx);
+  
+  return ctx;
+}
+
+/* Give the next files to other callbacks, between two files only */
+void GIF_DecoderSetCallbacks(GIF_Decoder * ctx, Uint32 flags,
+                             GIF_FrameFunc frame, GIF_RowFunc row,
+                             void * data) {
+  ctx->flags = flags;
+  ctx->frame = frame;
+  ctx->row = row;
+  ctx->data = data;
+}
+
+/* Get ready for a new file, the buffers are kept */
+void GIF_DecoderReset(GIF_Decoder * ctx) {
+  if (ctx->img.lcolTable != NULL && ctx->img.lcolTable != ctx->raw.gcolTable)
+    free(ctx->img.lcolTable);
+  if (ctx->raw.gcolTable != defaultColTable)
+    free(ctx->raw.gcolTable);
+  
+  ctx->raw.gcolTable = defaultColTable;
+  ctx->raw.img = &ctx->img;
+  ctx->gpal.cols = NULL;
+  ctx->lpal.cols = NULL;
+  ctx->raw.i = 0;
+  ctx->img.lcolTable = NULL;
+  
+  ctx->state = GIF_STATE_HEADER;
+  ctx->stop = 0;
+  ctx->len = 0;
+  ctx->n = 0;
+  ctx->dispMeth = 0;
+}
+
+void GIF_DecoderFree(GIF_Decoder * ctx) {
+  if (ctx == NULL)
+    return;
+  
+  GIF_DecoderReset(ctx);
+  GIF_LZW_StreamFree(ctx->lzw);
+  free(ctx->ext);
+  if (ctx->canvas != NULL)
+    SDL_FreeSurface(ctx->canvas);
+  if (ctx->save != NULL)
+    SDL_FreeSurface(ctx->save);
+  free(ctx);
+}
+
+/* Refuse the logical screens whose canvas doesn't fit in 'bytes' */
+void GIF_DecoderSetBudget(GIF_Decoder * ctx, Uint64 bytes) {
+  ctx->raw.budget = bytes;
+}
+
+SDL_Surface * GIF_DecoderGetCanvas(GIF_Decoder * ctx) {
+  return ctx->canvas;
+}
+
+/* Size of the logical screen, 0 until the header has been read */
+Uint16 GIF_DecoderGetWidth(GIF_Decoder * ctx) {
+  return ctx->state == GIF_STATE_HEADER ? 0 : ctx->raw.w;
+}
+
+Uint16 GIF_DecoderGetHeight(GIF_Decoder * ctx) {
+  return ctx->state == GIF_STATE_HEADER ? 0 : ctx->raw.h;
+}
+
+/* Only valid in the callbacks */
+void GIF_DecoderGetFrame(GIF_Decoder * ctx, GIF_FrameInfo * info) {
+  GIF_Image * img = &ctx->img;
+  
+  info->x = img->imgLftPos;
+  info->y = img->imgTopPos;
+  info->w = img->imgWidth;
+  info->h = img->imgHeight;
+  info->dispMeth = img->dispMeth;
+  info->interlace = img->interlace;
+  info->transp = img->transpColor ? img->transpColorIdx : -1;
+  info->delay = img->delay;
+}
+
+/* Called from a callback : GIF_DecoderPush returns 1 without reading more */
+void GIF_DecoderStop(GIF_Decoder * ctx) {
+  ctx->stop = 1;
+}
+
+
+
+/* #pragma mark Input */
+
+/* Return the next sz bytes once they have all arrived, NULL before.
+ * The bytes are only consumed by GIF_Decoder_Consume, so a block can be
+ * asked again with a bigger size once its header is known.
+ */
+static const Uint8 * GIF_Decoder_Need(GIF_Decoder * ctx, const Uint8 ** p,
+                                      Uint32 * n, Uint32 sz) {
+  Uint32 k;
+  
+  if (ctx->len >= sz)
+    return ctx->buf;
+  
+  if (ctx->len == 0 && *n >= sz)
+    return *p;
+  
+  k = sz - ctx->len;
+  if (k > *n)
+    k = *n;
+  
+  memcpy(ctx->buf + ctx->len, *p, k);
+  ctx->len += k;
+  *p += k;
+  *n -= k;
+  
+  return ctx->len >= sz ? ctx->buf : NULL;
+}
+
+static void GIF_Decoder_Consume(GIF_Decoder * ctx, const Uint8 ** p,
+                                Uint32 * n, Uint32 sz) {
+  if (ctx->len != 0) {
+    ctx->len = 0;
+  }
+  else {
+    *p += sz;
+    *n -= sz;
+  }
+}
+
+/* Append to the extension kept for its handler */
+static Sint8 GIF_Decoder_Keep(GIF_Decoder * ctx, const Uint8 * p, Uint32 n) {
+  Uint8 * tmp;
+  
+  if (ctx->extLen + n > ctx->extCap) {
+    tmp = realloc(ctx->ext, 2 * (ctx->extLen + n));
+    if (tmp == NULL) {
+      perror("GIF_DecoderPush : realloc");
+      return -1;
+    }
+    ctx->ext = tmp;
+    ctx->extCap = 2 * (ctx->extLen + n);
+  }
+  
+  memcpy(ctx->ext + ctx->extLen, p, n);
+  ctx->extLen += n;
+  
+  return 0;
+}
+
+/* Size of a color table from the packed fields of its descriptor */
+static Uint32 GIF_Decoder_ColorTableSize(Uint8 c) {
+  return (c & 0x80) ? 3 << ((c & 0x7) + 1) : 0;
+}
+
+
+
+/* #pragma mark Frames */
+
+static Sint8 GIF_Decoder_CreateCanvas(GIF_Decoder * ctx) {
+  if (ctx->canvas != NULL &&
+      (ctx->canvas->w != ctx->raw.w || ctx->canvas->h != ctx->raw.h)) {
+    SDL_FreeSurface(ctx->canvas);
+    ctx->canvas = NULL;
+    if (ctx->save != NULL)
+      SDL_FreeSurface(ctx->save);
+    ctx->save = NULL;
+  }
+  
+  if (ctx->canvas == NULL) {
+    ctx->canvas = GIF_CreateRGBSurface(ctx->raw.w, ctx->raw.h);
+    if (ctx->canvas == NULL)
+      return -1;
+  }
+  
+  SDL_FillRect(ctx->canvas, NULL, ctx->alpha);
+  SDL_SetColorKey(ctx->canvas, GIF_COLORKEY, ctx->alpha);
+  
+  return 0;
+}
+
+/* Copy the pixels of r from src to dst, color key included */
+static void GIF_Decoder_CopyRect(SDL_Surface * src, SDL_Surface * dst,
+                                 SDL_Rect * r) {
+  Sint32 x0, x1, y, y1;
+  
+  x0 = r->x;
+  x1 = r->x + r->w;
+  y1 = r->y + r->h;
+  if (x1 > dst->w)
+    x1 = dst->w;
+  if (y1 > dst->h)
+    y1 = dst->h;
+  if (x0 >= x1)
+    return;
+  
+  for (y = r->y; y < y1; y++)
+    memcpy(GIF_ROW(dst, y) + x0, GIF_ROW(src, y) + x0,
+           (x1 - x0) * sizeof(Uint32));
+}
+
+/* Dispose of the previous image and prepare the canvas for the new one */
+static Sint8 GIF_Decoder_BeginFrame(GIF_Decoder * ctx) {
+  GIF_Image * img = &ctx->img;
+  Uint32 i;
+  
+  ctx->pass = 0;
+  ctx->y = 0;
+  ctx->lzwDone = 0;
+  
+  if (ctx->flags & GIF_DECODER_NOCANVAS)
+    return 0;
+  
+  switch (ctx->dispMeth) {
+    case 2:
+      SDL_FillRect(ctx->canvas, &ctx->dispRect, ctx->alpha);
+      break;
+    
+    case 3:
+      if (SDL_MUSTLOCK(ctx->canvas))
+        SDL_LockSurface(ctx->canvas);
+      GIF_Decoder_CopyRect(ctx->save, ctx->canvas, &ctx->dispRect);
+      if (SDL_MUSTLOCK(ctx->canvas))
+        SDL_UnlockSurface(ctx->canvas);
+      break;
+    
+    default:
+      break;
+  }
+  
+  if (img->dispMeth == 3) {
+    if (ctx->save == NULL)
+      ctx->save = GIF_CreateRGBSurface(ctx->raw.w, ctx->raw.h);
+    if (ctx->save == NULL)
+      return -1;
+    
+    if (SDL_MUSTLOCK(ctx->canvas))
+      SDL_LockSurface(ctx->canvas);
+    for (i = 0; i < (Uint32)ctx->canvas->h; i++)
+      memcpy((Uint8 *)ctx->save->pixels + i * ctx->save->pitch,
+             (Uint8 *)ctx->canvas->pixels + i * ctx->canvas->pitch,
+             ctx->canvas->w * ctx->canvas->format->BytesPerPixel);
+    if (SDL_MUSTLOCK(ctx->canvas))
+      SDL_UnlockSurface(ctx->canvas);
+  }
+  
+  /* The global table is only converted once per file */
+  ctx->lut = GIF_PaletteMap(img->lcolTable == ctx->raw.gcolTable ? &ctx->gpal
+                                                                 : &ctx->lpal,
+                            img->lcolTable, img->nlcol);
+  
+  return 0;
+}
+
+static void GIF_Decoder_EndFrame(GIF_Decoder * ctx) {
+  GIF_Image * img = &ctx->img;
+  
+  if (ctx->frame != NULL)
+    ctx->frame(ctx->data, ctx->canvas, ctx->n, img->delay);
+  
+  ctx->dispMeth = img->dispMeth;
+  ctx->dispRect.x = img->imgLftPos;
+  ctx->dispRect.y = img->imgTopPos;
+  ctx->dispRect.w = img->imgWidth;
+  ctx->dispRect.h = img->imgHeight;
+  
+  if (img->lcolTable != ctx->raw.gcolTable) {
+    free(img->lcolTable);
+    ctx->lpal.cols = NULL;
+  }
+  
+  /* The graphic control extension only applies to one image */
+  GIF_InitImage(&ctx->raw, img);
+  ctx->n++;
+}
+
+/* Called by the LZW stream with each row of the image */
+static void GIF_Decoder_Row(void * data, Uint16 k, const Uint8 * idx) {
+  Uint8 start[4] = { 0, 4, 2, 1 };
+  Uint8 off[4] = { 8, 8, 4, 2 };
+  GIF_Decoder * ctx = data;
+  GIF_Image * img = &ctx->img;
+  SDL_Surface * dst = ctx->canvas;
+  const Uint8 * s;
+  GIF_Row row;
+  Uint32 x0, x1, x, y;
+  Uint32 * p;
+  
+  (void)k;
+  y = img->imgTopPos + ctx->y;
+  
+  /* Next row, de-interlaced */
+  if (img->interlace) {
+    ctx->y += off[ctx->pass];
+    while (ctx->y >= img->imgHeight && ++ctx->pass < 4)
+      ctx->y = start[ctx->pass];
+  }
+  else
+    ctx->y++;
+  
+  if (!(ctx->flags & GIF_DECODER_NOCANVAS) && y < (Uint32)dst->h) {
+    x0 = img->imgLftPos;
+    x1 = x0 + img->imgWidth;
+    if (x1 > (Uint32)dst->w)
+      x1 = dst->w;
+    
+    if (SDL_MUSTLOCK(dst))
+      SDL_LockSurface(dst);
+    
+    s = idx;
+    p = GIF_ROW(dst, y);
+    for (x = x0; x < x1; x++, s++) {
+      if (!img->transpColor || *s != img->transpColorIdx)
+        p[x] = ctx->lut[*s];
+    }
+    
+    if (SDL_MUSTLOCK(dst))
+      SDL_UnlockSurface(dst);
+  }
+  
+  if (ctx->row != NULL) {
+    row.frame = ctx->n;
+    row.x = img->imgLftPos;
+    row.y = y;
+    row.w = img->imgWidth;
+    row.idx = idx;
+    row.pal = img->lcolTable;
+    row.ncol = img->nlcol;
+    row.transp = img->transpColor ? img->transpColorIdx : -1;
+    ctx->row(ctx->data, &row);
+  }
+}
+
+
+
+/* #pragma mark Push */
+
+/* Decode as much as possible of the pushed bytes.
+ * Return 1 once the trailer is reached, -1 on error, 0 otherwise.
+ */
+int GIF_DecoderPush(GIF_Decoder * ctx, const Uint8 * bytes, Uint32 len) {
+  const Uint8 * q;
+  Uint32 sz;
+  Uint32 k;
+  int ret;
+  
+  while (1) {
+    if (ctx->stop)
+      return 1;
+    
+    switch (ctx->state) {
+      case GIF_STATE_HEADER:
+        q = GIF_Decoder_Need(ctx, &bytes, &len, 13);
+        if (q == NULL)
+          return 0;
+        sz = 13 + GIF_Decoder_ColorTableSize(q[10]);
+        q = GIF_Decoder_Need(ctx, &bytes, &len, sz);
+        if (q == NULL)
+          return 0;
+      
+        pdata = (Uint8 *)q;
+        ctx->raw.version = GIF_GetHeader();
+        if (ctx->raw.version != GIF_87A && ctx->raw.version != GIF_89A) {
+          fprintf(stderr, "GIF_DecoderPush : Not a GIF file.\n");
+          ctx->state = GIF_STATE_ERROR;
+          break;
+        }
+        if (GIF_GetLogScrDescriptor(&ctx->raw) < 0) {
+          ctx->state = GIF_STATE_ERROR;
+          break;
+        }
+        GIF_Decoder_Consume(ctx, &bytes, &len, sz);
+        GIF_InitImage(&ctx->raw, &ctx->img);
+      
+        if (!(ctx->flags & GIF_DECODER_NOCANVAS) &&
+            GIF_Decoder_CreateCanvas(ctx) < 0) {
+          ctx->state = GIF_STATE_ERROR;
+          break;
+        }
+        ctx->state = GIF_STATE_BLOCK;
+        break;
+      
+      case GIF_STATE_BLOCK:
+        q = GIF_Decoder_Need(ctx, &bytes, &len, 1);
+        if (q == NULL)
+          return 0;
+        k = *q;
+        GIF_Decoder_Consume(ctx, &bytes, &len, 1);
+      
+        switch (k) {
+          case 0x21:
+            ctx->state = GIF_STATE_EXTLABEL;
+            break;
+        
+          case 0x2C:
+            ctx->state = GIF_STATE_IMAGE;
+            break;
+        
+          case 0x3B:
+            ctx->state = GIF_STATE_DONE;
+            break;
+        
+          default:
+            fprintf(stderr, "GIF_DecoderPush : Unknown code.\n");
+            ctx->state = GIF_STATE_ERROR;
+            break;
+        }
+        break;
+      
+      case GIF_STATE_EXTLABEL:
+        q = GIF_Decoder_Need(ctx, &bytes, &len, 1);
+        if (q == NULL)
+          return 0;
+        k = *q;
+        GIF_Decoder_Consume(ctx, &bytes, &len, 1);
+        ctx->state = k == GIF_EXT_GRAPHCTRL ? GIF_STATE_GRAPHCTRL
+                                            : GIF_STATE_SKIPLEN;
+      
+        /* Only the extensions with a handler are gathered */
+        ctx->label = k;
+        ctx->keep = ctx->state == GIF_STATE_SKIPLEN && GIF_HasExtHandler(k);
+        ctx->extLen = 0;
+        break;
+      
+      case GIF_STATE_GRAPHCTRL:
+        /* Block size, 4 bytes, block terminator */
+        q = GIF_Decoder_Need(ctx, &bytes, &len, 6);
+        if (q == NULL)
+          return 0;
+        pdata = (Uint8 *)q;
+        if (GIF_GetGraphCtrlExt(&ctx->raw) < 0) {
+          ctx->state = GIF_STATE_ERROR;
+          break;
+        }
+        GIF_Decoder_Consume(ctx, &bytes, &len, 6);
+        ctx->state = GIF_STATE_BLOCK;
+        break;
+      
+      case GIF_STATE_SKIPLEN:
+      case GIF_STATE_DATALEN:
+        q = GIF_Decoder_Need(ctx, &bytes, &len, 1);
+        if (q == NULL)
+          return 0;
+        ctx->left = *q;
+        GIF_Decoder_Consume(ctx, &bytes, &len, 1);
+      
+        if (ctx->state == GIF_STATE_SKIPLEN && ctx->keep) {
+          if (ctx->left == 0)
+            GIF_CallExtHandler(ctx->label, ctx->ext, ctx->extLen);
+          else if (GIF_Decoder_Keep(ctx, q, 1) < 0) {
+            ctx->state = GIF_STATE_ERROR;
+            break;
+          }
+        }
+      
+        if (ctx->state == GIF_STATE_SKIPLEN)
+          ctx->state = ctx->left ? GIF_STATE_SKIPDATA : GIF_STATE_BLOCK;
+        else if (ctx->left)
+          ctx->state = GIF_STATE_DATA;
+        else {
+          if (!ctx->lzwDone)
+            GIF_Decoder_EndFrame(ctx);
+          ctx->state = GIF_STATE_BLOCK;
+        }
+        break;
+      
+      case GIF_STATE_SKIPDATA:
+      case GIF_STATE_DATA:
+        if (len == 0)
+          return 0;
+        k = ctx->left < len ? ctx->left : len;
+      
+        if (ctx->state == GIF_STATE_DATA && !ctx->lzwDone) {
+          ret = GIF_LZW_StreamPush(ctx->lzw, bytes, k);
+          if (ret < 0) {
+            ctx->state = GIF_STATE_ERROR;
+            break;
+          }
+          /* The frame is complete, the rest of the data is ignored */
+          if (ret == 1) {
+            ctx->lzwDone = 1;
+            GIF_Decoder_EndFrame(ctx);
+          }
+        }
+        else if (ctx->state == GIF_STATE_SKIPDATA && ctx->keep &&
+                 GIF_Decoder_Keep(ctx, bytes, k) < 0) {
+          ctx->state = GIF_STATE_ERROR;
+          break;
+        }
+      
+        bytes += k;
+        len -= k;
+        ctx->left -= k;
+        if (ctx->left == 0)
+          ctx->state = ctx->state == GIF_STATE_DATA ? GIF_STATE_DATALEN
+                                                    : GIF_STATE_SKIPLEN;
+        break;
+      
+      case GIF_STATE_IMAGE:
+        q = GIF_Decoder_Need(ctx, &bytes, &len, 9);
+        if (q == NULL)
+          return 0;
+        sz = 9 + GIF_Decoder_ColorTableSize(q[8]);
+        q = GIF_Decoder_Need(ctx, &bytes, &len, sz);
+        if (q == NULL)
+          return 0;
+      
+        pdata = (Uint8 *)q;
+        if (GIF_GetImgDescriptor(&ctx->raw) < 0 ||
+            GIF_Decoder_BeginFrame(ctx) < 0) {
+          ctx->state = GIF_STATE_ERROR;
+          break;
+        }
+        GIF_Decoder_Consume(ctx, &bytes, &len, sz);
+        ctx->state = GIF_STATE_MINCODE;
+        break;
+      
+      case GIF_STATE_MINCODE:
+        q = GIF_Decoder_Need(ctx, &bytes, &len, 1);
+        if (q == NULL)
+          return 0;
+        k = *q;
+        GIF_Decoder_Consume(ctx, &bytes, &len, 1);
+      
+        if (GIF_LZW_StreamInit(ctx->lzw, k, ctx->img.imgWidth,
+                               ctx->img.imgHeight, GIF_Decoder_Row, ctx) < 0) {
+          ctx->state = GIF_STATE_ERROR;
+          break;
+        }
+        ctx->state = GIF_STATE_DATALEN;
+        break;
+      
+      case GIF_STATE_DONE:
+        return 1;
+      
+      case GIF_STATE_ERROR:
+      default:
+        return -1;
+    }
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef GIF_DECODER_H
+#define GIF_DECODER_H
+
+/* Incremental decoder : the file is pushed in pieces of any size as it is
+ * received, rows and frames are given to the callbacks as soon as their
+ * data has arrived.
+ */
+
+typedef struct GIF_Decoder_s GIF_Decoder;
+
+/* A decoded row, in logical screen coordinates (not clipped) */
+typedef struct {
+  Uint32 frame;
+  Uint16 x;
+  Uint16 y;
+  Uint16 w;
+  const Uint8 * idx;      /* Color index of the w pixels */
+  const SDL_Color * pal;  /* Colors of the frame */
+  Uint16 ncol;            /* Entries of 'pal', the indices past it are black */
+  Sint16 transp;          /* Transparent index, -1 if none */
+} GIF_Row;
+
+/* Image being decoded, in logical screen coordinates */
+typedef struct {
+  Uint16 x;
+  Uint16 y;
+  Uint16 w;
+  Uint16 h;
+  Uint8 dispMeth;
+  Uint8 interlace;
+  Sint16 transp;          /* Transparent index, -1 if none */
+  Uint16 delay;
+} GIF_FrameInfo;
+
+/* 'canvas' is NULL with GIF_DECODER_NOCANVAS */
+typedef void (*GIF_FrameFunc)(void * data, SDL_Surface * canvas,
+                              Uint32 frame, Uint16 delay);
+typedef void (*GIF_RowFunc)(void * data, const GIF_Row * row);
+
+enum {
+  GIF_DECODER_NOCANVAS = 0x01   /* Only give the rows, don't composite */
+};
+
+GIF_Decoder * GIF_DecoderCreate(Uint32 flags, GIF_FrameFunc frame,
+                                GIF_RowFunc row, void * data);
+void GIF_DecoderSetCallbacks(GIF_Decoder * ctx, Uint32 flags,
+                             GIF_FrameFunc frame, GIF_RowFunc row,
+                             void * data);
+void GIF_DecoderReset(GIF_Decoder * ctx);
+void GIF_DecoderSetBudget(GIF_Decoder * ctx, Uint64 bytes);
+int GIF_DecoderPush(GIF_Decoder * ctx, const Uint8 * bytes, Uint32 len);
+SDL_Surface * GIF_DecoderGetCanvas(GIF_Decoder * ctx);
+Uint16 GIF_DecoderGetWidth(GIF_Decoder * ctx);
+Uint16 GIF_DecoderGetHeight(GIF_Decoder * ctx);
+void GIF_DecoderGetFrame(GIF_Decoder * ctx, GIF_FrameInfo * info);
+void GIF_DecoderStop(GIF_Decoder * ctx);
+void GIF_DecoderFree(GIF_Decoder * ctx);
+
+#endif
@@ -0,0 +1,388 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Encode.h"
+#include "GIF_LZW.h"
+
+
+/* Bytes of a block being written */
+typedef struct {
+  Uint8 * p;
+  Uint32 n;
+  Uint32 cap;
+} GIF_Buffer;
+
+struct GIF_Encoder_s {
+  FILE * f;
+  Uint16 w;
+  Uint16 h;
+  Uint16 ngcol;       /* Size of the global color table, 0 if none */
+  Uint32 nframes;
+  GIF_Buffer buf;     /* Reused for each frame */
+};
+
+
+
+static int GIF_BufGrow(GIF_Buffer * buf, Uint32 n) {
+  Uint8 * p;
+  Uint32 cap;
+  
+  if (buf->n + n <= buf->cap)
+    return 0;
+  
+  cap = buf->cap == 0 ? 1024 : buf->cap;
+  while (cap < buf->n + n)
+    cap *= 2;
+  
+  p = realloc(buf->p, cap);
+  if (p == NULL) {
+    perror("GIF_BufGrow : realloc");
+    return -1;
+  }
+  buf->p = p;
+  buf->cap = cap;
+  
+  return 0;
+}
+
+static int GIF_PutBytes(GIF_Buffer * buf, const void * s, Uint32 n) {
+  if (GIF_BufGrow(buf, n) < 0)
+    return -1;
+  
+  memcpy(buf->p + buf->n, s, n);
+  buf->n += n;
+  
+  return 0;
+}
+
+static int GIF_PutByte(GIF_Buffer * buf, Uint8 c) {
+  return GIF_PutBytes(buf, &c, 1);
+}
+
+/* Put n in nb bytes, byte ordered (see GIF_GetInt) */
+static int GIF_PutInt(GIF_Buffer * buf, unsigned n, int nb) {
+  Uint8 s[4];
+  int i;
+  
+  for (i = 0; i < nb; i++)
+    s[i] = n >> (8 * i);
+  
+  return GIF_PutBytes(buf, s, nb);
+}
+
+/* A color table holds 2**(n+1) colors : smallest n for 'ncol' colors */
+static Uint8 GIF_ColorTableSize(Uint16 ncol) {
+  Uint8 n = 0;
+  
+  while ((2 << n) < ncol)
+    n++;
+  
+  return n;
+}
+
+/* The table is padded with black up to 2**(n+1) colors */
+static int GIF_PutColorTable(GIF_Buffer * buf, const SDL_Color * cols,
+                             Uint16 ncol, Uint8 n) {
+  Uint32 i;
+  Uint8 rgb[3];
+  
+  for (i = 0; i < (2U << n); i++) {
+    rgb[0] = rgb[1] = rgb[2] = 0;
+    if (i < ncol) {
+      rgb[0] = cols[i].r;
+      rgb[1] = cols[i].g;
+      rgb[2] = cols[i].b;
+    }
+    if (GIF_PutBytes(buf, rgb, 3) < 0)
+      return -1;
+  }
+  
+  return 0;
+}
+
+
+
+/* #pragma mark Blocks */
+
+/* Header and Logical Screen Descriptor, see GIF_GetHeader and
+ * GIF_GetLogScrDescriptor for the layouts.
+ * The color resolution is always 8 bits.
+ */
+static int GIF_PutScreen(GIF_Buffer * buf, Uint16 w, Uint16 h,
+                         const SDL_Color * gcol, Uint16 ngcol,
+                         Uint8 bckColIndex) {
+  Uint8 n = GIF_ColorTableSize(ngcol);
+  Uint8 flags = 0x70;
+  
+  if (gcol != NULL)
+    flags |= 0x80 | n;
+  
+  if (GIF_PutBytes(buf, "GIF89a", 6) < 0 ||
+      GIF_PutInt(buf, w, 2) < 0 ||
+      GIF_PutInt(buf, h, 2) < 0 ||
+      GIF_PutByte(buf, flags) < 0 ||
+      GIF_PutByte(buf, bckColIndex) < 0 ||
+      GIF_PutByte(buf, 0) < 0)
+    return -1;
+  
+  if (gcol != NULL)
+    return GIF_PutColorTable(buf, gcol, ngcol, n);
+  
+  return 0;
+}
+
+/* Application Extension "NETSCAPE2.0" - 19 bytes :
+ * -> 3 bytes  : Extension introducer, label and block size (11)
+ * -> 11 bytes : "NETSCAPE2.0"
+ * -> 1 byte   : Sub-block size - fixed value 3
+ * -> 1 byte   : Sub-block ID - fixed value 1
+ * -> 2 bytes  : Loop count, 0 for ever
+ * -> 1 byte   : block terminator - fixed value 0x00
+ */
+static int GIF_PutLoopExt(GIF_Buffer * buf, Uint16 loop) {
+  if (GIF_PutBytes(buf, "\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01", 16) < 0 ||
+      GIF_PutInt(buf, loop, 2) < 0 ||
+      GIF_PutByte(buf, 0) < 0)
+    return -1;
+  
+  return 0;
+}
+
+/* Graphic Control Extension, see GIF_GetGraphCtrlExt */
+static int GIF_PutGraphCtrlExt(GIF_Buffer * buf, const GIF_Frame * fr) {
+  Uint8 flags = (fr->dispMeth & 0x7) << 2;
+  
+  if (fr->transp >= 0)
+    flags |= 1;
+  
+  if (GIF_PutBytes(buf, "\x21\xF9\x04", 3) < 0 ||
+      GIF_PutByte(buf, flags) < 0 ||
+      GIF_PutInt(buf, fr->delay, 2) < 0 ||
+      GIF_PutByte(buf, fr->transp >= 0 ? fr->transp : 0) < 0 ||
+      GIF_PutByte(buf, 0) < 0)
+    return -1;
+  
+  return 0;
+}
+
+/* Image Descriptor and local color table, see GIF_GetImgDescriptor */
+static int GIF_PutImgDescriptor(GIF_Buffer * buf, const GIF_Frame * fr) {
+  Uint8 n = GIF_ColorTableSize(fr->npal);
+  Uint8 flags = 0;
+  
+  if (fr->pal != NULL)
+    flags = 0x80 | n;
+  if (fr->interlace)
+    flags |= 0x40;
+  
+  if (GIF_PutByte(buf, 0x2C) < 0 ||
+      GIF_PutInt(buf, fr->x, 2) < 0 ||
+      GIF_PutInt(buf, fr->y, 2) < 0 ||
+      GIF_PutInt(buf, fr->w, 2) < 0 ||
+      GIF_PutInt(buf, fr->h, 2) < 0 ||
+      GIF_PutByte(buf, flags) < 0)
+    return -1;
+  
+  if (fr->pal != NULL)
+    return GIF_PutColorTable(buf, fr->pal, fr->npal, n);
+  
+  return 0;
+}
+
+/* Image data :
+ * -> 1 byte  : LZW minimum code size
+ * -> Data sub-blocks of 255 bytes at most
+ * -> 1 byte  : block terminator - fixed value 0x00
+ */
+static int GIF_PutImageData(GIF_Buffer * buf, const GIF_Frame * fr,
+                            Uint8 minCdeSz) {
+  Uint8 start[4] = { 0, 4, 2, 1 };
+  Uint8 off[4] = { 8, 8, 4, 2 };
+  const Uint8 * idx = fr->idx;
+  Uint8 * rows = NULL;
+  Uint8 * lzw;
+  Uint32 sz, i, k, y;
+  
+  /* Rows 0, 8, 16..., then 4, 12..., then 2, 6..., then 1, 3... */
+  if (fr->interlace) {
+    rows = malloc((Uint32)fr->w * fr->h);
+    if (rows == NULL) {
+      perror("GIF_PutImageData : malloc");
+      return -1;
+    }
+    for (i = 0, k = 0; k < 4; k++)
+      for (y = start[k]; y < fr->h; y += off[k], i++)
+        memcpy(rows + i * fr->w, fr->idx + y * fr->w, fr->w);
+    idx = rows;
+  }
+  
+  lzw = GIF_LZW_Compress(idx, (Uint32)fr->w * fr->h, minCdeSz, &sz);
+  free(rows);
+  if (lzw == NULL)
+    return -1;
+  
+  /* One size byte for each 255 bytes of data */
+  if (GIF_BufGrow(buf, 2 + sz + sz / 255 + 1) < 0) {
+    free(lzw);
+    return -1;
+  }
+  
+  buf->p[buf->n++] = minCdeSz;
+  for (i = 0; i < sz; i += k) {
+    k = sz - i < 255 ? sz - i : 255;
+    buf->p[buf->n++] = k;
+    memcpy(buf->p + buf->n, lzw + i, k);
+    buf->n += k;
+  }
+  buf->p[buf->n++] = 0;
+  
+  free(lzw);
+  
+  return 0;
+}
+
+/* Every block of a frame, in 'buf' */
+static int GIF_EncodeFrame(GIF_Encoder * enc, const GIF_Frame * fr,
+                           GIF_Buffer * buf) {
+  Uint16 ncol = fr->pal != NULL ? fr->npal : enc->ngcol;
+  Uint32 i, n = (Uint32)fr->w * fr->h;
+  Uint8 minCdeSz;
+  
+  if (ncol == 0 || ncol > 256 || fr->w == 0 || fr->h == 0 ||
+      fr->x + fr->w > enc->w || fr->y + fr->h > enc->h) {
+    fprintf(stderr, "GIF_EncoderAddFrame : Bad frame.\n");
+    return -1;
+  }
+  
+  for (i = 0; i < n; i++)
+    if (fr->idx[i] >= ncol) {
+      fprintf(stderr, "GIF_EncoderAddFrame : Index out of the palette.\n");
+      return -1;
+    }
+  
+  /* The decoder needs at least 2 bits */
+  minCdeSz = GIF_ColorTableSize(ncol) + 1;
+  if (minCdeSz < 2)
+    minCdeSz = 2;
+  
+  if (GIF_PutGraphCtrlExt(buf, fr) < 0 ||
+      GIF_PutImgDescriptor(buf, fr) < 0 ||
+      GIF_PutImageData(buf, fr, minCdeSz) < 0)
+    return -1;
+  
+  return 0;
+}
+
+static int GIF_EncoderFlush(GIF_Encoder * enc) {
+  if (fwrite(enc->buf.p, 1, enc->buf.n, enc->f) != enc->buf.n) {
+    fprintf(stderr, "GIF_Encoder : fwrite: File error.\n");
+    return -1;
+  }
+  enc->buf.n = 0;
+  
+  return 0;
+}
+
+
+
+/* #pragma mark Encoder */
+
+GIF_Encoder * GIF_EncoderCreate(char * file, Uint16 w, Uint16 h,
+                                const SDL_Color * gcol, Uint16 ngcol,
+                                Uint8 bckColIndex, Sint32 loop) {
+  GIF_Encoder * enc;
+  
+  if (w == 0 || h == 0 || (gcol != NULL && (ngcol == 0 || ngcol > 256))) {
+    fprintf(stderr, "GIF_EncoderCreate : Bad screen.\n");
+    return NULL;
+  }
+  
+  enc = calloc(1, sizeof *enc);
+  if (enc == NULL)
+    return NULL;
+  
+  enc->w = w;
+  enc->h = h;
+  enc->ngcol = gcol != NULL ? ngcol : 0;
+  
+  enc->f = fopen(file, "wb");
+  if (enc->f == NULL) {
+    perror("GIF_EncoderCreate : fopen");
+    free(enc);
+    return NULL;
+  }
+  
+  if (GIF_PutScreen(&enc->buf, w, h, gcol, ngcol, bckColIndex) < 0 ||
+      (loop >= 0 && GIF_PutLoopExt(&enc->buf, loop) < 0) ||
+      GIF_EncoderFlush(enc) < 0) {
+    fclose(enc->f);
+    free(enc->buf.p);
+    free(enc);
+    return NULL;
+  }
+  
+  return enc;
+}
+
+int GIF_EncoderAddFrame(GIF_Encoder * enc, const GIF_Frame * frame) {
+  if (GIF_EncodeFrame(enc, frame, &enc->buf) < 0) {
+    enc->buf.n = 0;
+    return -1;
+  }
+  
+  if (GIF_EncoderFlush(enc) < 0)
+    return -1;
+  
+  enc->nframes++;
+  
+  return 0;
+}
+
+/* Only reads 'enc' : can run on several threads at once */
+int GIF_EncoderEncodeFrame(GIF_Encoder * enc, const GIF_Frame * frame,
+                           Uint8 ** blob, Uint32 * sz) {
+  GIF_Buffer buf = { NULL, 0, 0 };
+  
+  if (GIF_EncodeFrame(enc, frame, &buf) < 0) {
+    free(buf.p);
+    return -1;
+  }
+  
+  *blob = buf.p;
+  *sz = buf.n;
+  
+  return 0;
+}
+
+int GIF_EncoderWriteFrame(GIF_Encoder * enc, Uint8 * blob, Uint32 sz) {
+  size_t n = fwrite(blob, 1, sz, enc->f);
+  
+  free(blob);
+  if (n != sz) {
+    fprintf(stderr, "GIF_Encoder : fwrite: File error.\n");
+    return -1;
+  }
+  
+  enc->nframes++;
+  
+  return 0;
+}
+
+/* Write the trailer and free the encoder */
+int GIF_EncoderClose(GIF_Encoder * enc) {
+  int ret = 0;
+  
+  if (GIF_PutByte(&enc->buf, 0x3B) < 0 || GIF_EncoderFlush(enc) < 0)
+    ret = -1;
+  
+  if (fclose(enc->f) != 0)
+    ret = -1;
+  
+  free(enc->buf.p);
+  free(enc);
+  
+  return ret;
+}
@@ -0,0 +1,41 @@
+#ifndef GIF_ENCODE_H
+#define GIF_ENCODE_H
+
+/* GIF89a writer : frames are given as index planes with their palette and
+ * written one after the other.
+ */
+
+typedef struct GIF_Encoder_s GIF_Encoder;
+
+typedef struct {
+  Uint16 x;               /* Position on the logical screen */
+  Uint16 y;
+  Uint16 w;
+  Uint16 h;
+  const Uint8 * idx;      /* w * h color indexes, row by row */
+  const SDL_Color * pal;  /* Local color table, NULL for the global one */
+  Uint16 npal;            /* Number of colors in 'pal' (256 max) */
+  Uint16 delay;           /* 1/100 s */
+  Uint8 dispMeth;         /* Disposal method, as in the Graphic Control Ext. */
+  Sint16 transp;          /* Transparent index, -1 if none */
+  Uint8 interlace;        /* Rows written in 4 passes, 'idx' is in order */
+} GIF_Frame;
+
+/* 'gcol' can be NULL if every frame has a local color table.
+ * 'loop' is the number of repetitions, 0 forever, -1 to play once.
+ */
+GIF_Encoder * GIF_EncoderCreate(char * file, Uint16 w, Uint16 h,
+                                const SDL_Color * gcol, Uint16 ngcol,
+                                Uint8 bckColIndex, Sint32 loop);
+int GIF_EncoderAddFrame(GIF_Encoder * enc, const GIF_Frame * frame);
+int GIF_EncoderClose(GIF_Encoder * enc);
+
+/* GIF_EncoderAddFrame in two steps, for pipelines : the blocks of a frame
+ * can be built on any thread, they are then written in order.
+ * The blob is freed by GIF_EncoderWriteFrame.
+ */
+int GIF_EncoderEncodeFrame(GIF_Encoder * enc, const GIF_Frame * frame,
+                           Uint8 ** blob, Uint32 * sz);
+int GIF_EncoderWriteFrame(GIF_Encoder * enc, Uint8 * blob, Uint32 sz);
+
+#endif
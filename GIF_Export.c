@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Export.h"
+#include "GIF_Encode.h"
+#include "GIF_Optimize.h"
+#include "GIF_Quantize.h"
+
+
+/* The frames go through three stages :
+ * -> differencing, in order on the calling thread (the rectangle of a
+ *    frame depends on the disposal chosen for the previous one)
+ * -> quantization and LZW compression, as pool tasks
+ * -> writing, in order on the calling thread
+ * A job only depends on its own frame, so the output does not depend on
+ * the number of threads.
+ */
+
+enum {
+  GIF_EXPORT_INFLIGHT = 32    /* Frames between differencing and writing */
+};
+
+typedef struct {
+  struct GIF_Export_s * exp;
+  GIF_Frame fr;
+  Uint8 * rgba;       /* fr.w * fr.h pixels, kept between frames */
+  Uint8 * idx;
+  Uint32 cap;         /* Pixels allocated in 'rgba' and 'idx' */
+  SDL_Color pal[256];
+  
+  Uint8 * blob;       /* Blocks of the frame */
+  Uint32 sz;
+  Uint8 done;
+  Sint8 ret;
+} GIF_ExportJob;
+
+struct GIF_Export_s {
+  GIF_Encoder * enc;
+  GIF_Optimizer * opt;
+  GIF_Pool * pool;
+  Uint32 flags;
+  Uint16 w;
+  Uint16 h;
+  Uint16 delay;                 /* Delay of the frame held by 'opt' */
+  
+  GIF_Quantizer ** quant;       /* One per worker, the last for no pool */
+  int nquant;
+  
+  GIF_ExportJob jobs[GIF_EXPORT_INFLIGHT];
+  Uint32 first;                 /* Oldest job not written */
+  Uint32 next;                  /* Next job to fill */
+  
+  SDL_mutex * lock;             /* Protects the 'done' fields */
+  SDL_cond * cond;              /* Signaled when a job is done */
+  int err;
+};
+
+
+
+/* #pragma mark Jobs */
+
+/* Palette, indexes and blocks of one frame */
+static void GIF_ExportTask(void * data, int worker) {
+  GIF_ExportJob * job = data;
+  GIF_Export * exp = job->exp;
+  GIF_Quantizer * q = exp->quant[worker];
+  GIF_Frame * fr = &job->fr;
+  Uint32 pitch = (Uint32)fr->w * 4;
+  Uint16 npal;
+  Sint16 transp;
+  int ret;
+  
+  GIF_QuantizerReset(q);
+  GIF_QuantizerAdd(q, job->rgba, fr->w, fr->h, pitch);
+  ret = GIF_QuantizerPalette(q, 256, job->pal, &npal, &transp);
+  if (ret == 0) {
+    GIF_QuantizerMap(q, job->rgba, fr->w, fr->h, pitch,
+                     exp->flags & GIF_EXPORT_DITHER ? GIF_QUANT_DITHER : 0,
+                     job->idx);
+    fr->idx = job->idx;
+    fr->pal = job->pal;
+    fr->npal = npal;
+    fr->transp = transp;
+    ret = GIF_EncoderEncodeFrame(exp->enc, fr, &job->blob, &job->sz);
+  }
+  
+  SDL_LockMutex(exp->lock);
+  job->ret = ret;
+  job->done = 1;
+  SDL_CondSignal(exp->cond);
+  SDL_UnlockMutex(exp->lock);
+}
+
+/* Write the jobs done, in order, waiting for those before 'until' */
+static void GIF_ExportDrain(GIF_Export * exp, Uint32 until) {
+  GIF_ExportJob * job;
+  Uint8 done;
+  
+  while (exp->first != exp->next) {
+    job = &exp->jobs[exp->first % GIF_EXPORT_INFLIGHT];
+    
+    SDL_LockMutex(exp->lock);
+    while (!job->done && (Sint32)(until - exp->first) > 0)
+      SDL_CondWait(exp->cond, exp->lock);
+    done = job->done;
+    SDL_UnlockMutex(exp->lock);
+    
+    if (!done)
+      break;
+    
+    if (job->ret < 0)
+      exp->err = -1;
+    else if (exp->err == 0 &&
+             GIF_EncoderWriteFrame(exp->enc, job->blob, job->sz) < 0)
+      exp->err = -1;
+    else if (exp->err != 0)
+      free(job->blob);
+    job->blob = NULL;
+    
+    exp->first++;
+  }
+}
+
+static int GIF_ExportSubmit(GIF_Export * exp, const GIF_DiffFrame * d,
+                            Uint32 pitch, Uint16 delay) {
+  GIF_ExportJob * job;
+  Uint32 n = (Uint32)d->w * d->h;
+  Uint32 y;
+  Uint8 * p;
+  
+  /* Wait for the oldest job if they are all in use */
+  if (exp->next - exp->first == GIF_EXPORT_INFLIGHT)
+    GIF_ExportDrain(exp, exp->first + 1);
+  
+  job = &exp->jobs[exp->next % GIF_EXPORT_INFLIGHT];
+  
+  if (n > job->cap) {
+    p = realloc(job->rgba, n * 4);
+    if (p == NULL)
+      return -1;
+    job->rgba = p;
+    p = realloc(job->idx, n);
+    if (p == NULL)
+      return -1;
+    job->idx = p;
+    job->cap = n;
+  }
+  
+  for (y = 0; y < d->h; y++)
+    memcpy(job->rgba + y * d->w * 4, d->rgba + y * pitch, d->w * 4);
+  job->exp = exp;
+  job->fr.x = d->x;
+  job->fr.y = d->y;
+  job->fr.w = d->w;
+  job->fr.h = d->h;
+  job->fr.delay = delay;
+  job->fr.dispMeth = d->dispMeth;
+  job->fr.interlace = 0;
+  job->done = 0;
+  job->blob = NULL;
+  exp->next++;
+  
+  if (exp->pool == NULL)
+    GIF_ExportTask(job, exp->nquant - 1);
+  else if (GIF_PoolSubmit(exp->pool, GIF_ExportTask, job) < 0) {
+    exp->next--;
+    return -1;
+  }
+  
+  GIF_ExportDrain(exp, exp->first);
+  
+  return exp->err;
+}
+
+
+
+/* #pragma mark Export */
+
+GIF_Export * GIF_ExportCreate(char * file, Uint16 w, Uint16 h, Uint32 flags,
+                              GIF_Pool * pool) {
+  GIF_Export * exp;
+  int i;
+  
+  exp = calloc(1, sizeof *exp);
+  if (exp == NULL)
+    return NULL;
+  
+  exp->pool = pool;
+  exp->flags = flags;
+  exp->w = w;
+  exp->h = h;
+  exp->nquant = (pool != NULL ? GIF_PoolSize(pool) : 0) + 1;
+  
+  exp->quant = calloc(exp->nquant, sizeof *exp->quant);
+  exp->lock = SDL_CreateMutex();
+  exp->cond = SDL_CreateCond();
+  exp->opt = GIF_OptimizerCreate(w, h);
+  if (exp->quant == NULL || exp->lock == NULL || exp->cond == NULL ||
+      exp->opt == NULL)
+    goto error;
+  
+  for (i = 0; i < exp->nquant; i++) {
+    exp->quant[i] = GIF_QuantizerCreate();
+    if (exp->quant[i] == NULL)
+      goto error;
+  }
+  
+  exp->enc = GIF_EncoderCreate(file, w, h, NULL, 0, 0, 0);
+  if (exp->enc == NULL)
+    goto error;
+  
+  return exp;
+  
+error:
+  exp->err = -1;
+  GIF_ExportClose(exp);
+  return NULL;
+}
+
+int GIF_ExportFrame(GIF_Export * exp, const Uint8 * rgba, Uint32 pitch,
+                    Uint16 delay) {
+  GIF_DiffFrame d;
+  int ret = 0;
+  
+  if (exp->err != 0)
+    return -1;
+  
+  if (exp->flags & GIF_EXPORT_NODIFF) {
+    d.x = 0;
+    d.y = 0;
+    d.w = exp->w;
+    d.h = exp->h;
+    d.dispMeth = 2;
+    d.rgba = rgba;
+    return GIF_ExportSubmit(exp, &d, pitch, delay);
+  }
+  
+  /* The frame given back is the previous one */
+  if (GIF_OptimizerPush(exp->opt, rgba, pitch, &d) == 1)
+    ret = GIF_ExportSubmit(exp, &d, (Uint32)d.w * 4, exp->delay);
+  exp->delay = delay;
+  
+  return ret;
+}
+
+/* Write the frames left and the trailer, free everything */
+int GIF_ExportClose(GIF_Export * exp) {
+  GIF_DiffFrame d;
+  int ret, i;
+  
+  if (exp->err == 0 && exp->opt != NULL &&
+      GIF_OptimizerFlush(exp->opt, &d) == 1)
+    GIF_ExportSubmit(exp, &d, (Uint32)d.w * 4, exp->delay);
+  
+  GIF_ExportDrain(exp, exp->next);
+  ret = exp->err;
+  
+  if (exp->enc != NULL && GIF_EncoderClose(exp->enc) < 0)
+    ret = -1;
+  
+  for (i = 0; i < GIF_EXPORT_INFLIGHT; i++) {
+    free(exp->jobs[i].rgba);
+    free(exp->jobs[i].idx);
+  }
+  for (i = 0; exp->quant != NULL && i < exp->nquant; i++)
+    GIF_QuantizerFree(exp->quant[i]);
+  free(exp->quant);
+  GIF_OptimizerFree(exp->opt);
+  if (exp->cond != NULL)
+    SDL_DestroyCond(exp->cond);
+  if (exp->lock != NULL)
+    SDL_DestroyMutex(exp->lock);
+  free(exp);
+  
+  return ret;
+}
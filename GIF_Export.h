@@ -0,0 +1,26 @@
+#ifndef GIF_EXPORT_H
+#define GIF_EXPORT_H
+
+/* Truecolor animation to GIF : frame differencing, a palette per frame and
+ * LZW compression. With a pool, the frames are quantized and compressed in
+ * parallel, the file is the same as without.
+ */
+
+#include "GIF_Pool.h"
+
+typedef struct GIF_Export_s GIF_Export;
+
+enum {
+  GIF_EXPORT_DITHER = 0x01,   /* Ordered dithering */
+  GIF_EXPORT_NODIFF = 0x02    /* Write whole frames */
+};
+
+/* 'pool' can be NULL to do everything on the calling thread */
+GIF_Export * GIF_ExportCreate(char * file, Uint16 w, Uint16 h, Uint32 flags,
+                              GIF_Pool * pool);
+/* 'rgba' is w * h pixels, 4 bytes each in R, G, B, A order */
+int GIF_ExportFrame(GIF_Export * exp, const Uint8 * rgba, Uint32 pitch,
+                    Uint16 delay);
+int GIF_ExportClose(GIF_Export * exp);
+
+#endif
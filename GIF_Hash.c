@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Hash.h"
+
+
+/* Hash n bytes of s, continuing from h (GIF_HASH_SEED to start).
+ * Works on 32 bits words, the hash is only used to find candidates,
+ * matches are always checked byte by byte.
+ */
+Uint32 GIF_Hash(Uint32 h, const void * s, Uint32 n) {
+  const Uint8 * p = s;
+  Uint32 w;
+  
+  while (n >= 4) {
+    memcpy(&w, p, 4);
+    h = (h ^ w) * 0x9E3779B1;
+    h ^= h >> 15;
+    p += 4;
+    n -= 4;
+  }
+  
+  while (n != 0) {
+    h = (h ^ *p++) * 0x01000193;
+    n--;
+  }
+  
+  return h;
+}
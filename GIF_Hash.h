@@ -0,0 +1,12 @@
+#ifndef GIF_HASH_H
+#define GIF_HASH_H
+
+#include <SDL.h>
+
+enum {
+  GIF_HASH_SEED = 0x811C9DC5
+};
+
+Uint32 GIF_Hash(Uint32 h, const void * s, Uint32 n);
+
+#endif
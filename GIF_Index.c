@@ -0,0 +1,539 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Struct.h"
+#include "GIF_Render.h"
+#include "GIF_Index.h"
+#include "GIF_Hash.h"
+
+
+enum {
+  GIF_INDEX_NCOL = 256,
+  GIF_INDEX_TRANSP = 0,   /* Index reserved for transparent pixels */
+  GIF_INDEX_LITMAX = 128, /* Longest literal block */
+  GIF_INDEX_RUNMIN = 3,   /* Shortest run worth encoding */
+  GIF_INDEX_RUNMAX = 130  /* Longest run : 255 - 128 + GIF_INDEX_RUNMIN */
+};
+
+/* State of the index canvas while compositing */
+typedef struct {
+  Uint8 * canvas;   /* Current composited indices */
+  Uint8 * save;     /* Canvas saved for disposal method 3 */
+  Uint8 saved;      /* 'save' is restored after the current image */
+  Uint8 * prev;     /* Previous frame, for delta encoding */
+  Uint8 * tmp;      /* Encoding buffer */
+  
+  GIF_Color pal[GIF_INDEX_NCOL];
+  Uint16 npal;      /* Used entries in 'pal', including the transparent one */
+  Uint8 dirty;      /* 'pal' changed since the last snapshot */
+} GIF_IndexCtx;
+
+
+
+/* Run-length encoding, one control byte per block :
+ * -> 0 - 127   : (n + 1) literal bytes follow
+ * -> 128 - 255 : the next byte is repeated (n - 128 + GIF_INDEX_RUNMIN) times
+ */
+
+static Uint8 * GIF_Index_RLELiterals(Uint8 * p, const Uint8 * s, Uint32 n) {
+  Uint32 k;
+  
+  while (n != 0) {
+    k = n < GIF_INDEX_LITMAX ? n : GIF_INDEX_LITMAX;
+    *p++ = k - 1;
+    memcpy(p, s, k);
+    p += k;
+    s += k;
+    n -= k;
+  }
+  
+  return p;
+}
+
+static Uint32 GIF_Index_RLEEncode(Uint8 * dst, const Uint8 * src, Uint32 n) {
+  Uint8 * p = dst;
+  Uint32 i, lit, run;
+  
+  i = lit = 0;
+  while (i < n) {
+    run = 1;
+    while (i + run < n && run < GIF_INDEX_RUNMAX && src[i + run] == src[i])
+      run++;
+    
+    if (run >= GIF_INDEX_RUNMIN) {
+      p = GIF_Index_RLELiterals(p, src + lit, i - lit);
+      *p++ = 128 + run - GIF_INDEX_RUNMIN;
+      *p++ = src[i];
+      lit = i + run;
+    }
+    i += run;
+  }
+  p = GIF_Index_RLELiterals(p, src + lit, n - lit);
+  
+  return p - dst;
+}
+
+/* Decode 'src' into 'dst', xor-ing with its content for delta frames */
+static void GIF_Index_RLEDecode(Uint8 * dst, const Uint8 * src, Uint32 sz,
+                                int delta) {
+  const Uint8 * end = src + sz;
+  Uint32 k, n;
+  Uint8 c;
+  
+  while (src < end) {
+    c = *src++;
+    
+    if (c < 128) {
+      n = c + 1;
+      if (delta)
+        for (k = 0; k < n; k++)
+          dst[k] ^= src[k];
+      else
+        memcpy(dst, src, n);
+      src += n;
+    }
+    else {
+      n = c - 128 + GIF_INDEX_RUNMIN;
+      c = *src++;
+      if (delta)
+        for (k = 0; k < n; k++)
+          dst[k] ^= c;
+      else
+        memset(dst, c, n);
+    }
+    dst += n;
+  }
+}
+
+
+
+/* #pragma mark Palette */
+
+static int GIF_Index_FindColor(GIF_IndexCtx * ctx, GIF_Color * c) {
+  int i;
+  
+  for (i = GIF_INDEX_TRANSP + 1; i < ctx->npal; i++) {
+    if (ctx->pal[i].r == c->r && ctx->pal[i].g == c->g && ctx->pal[i].b == c->b)
+      return i;
+  }
+  
+  return -1;
+}
+
+/* Drop the palette entries the canvas doesn't use anymore, nor the saved
+ * canvas while it is to be restored
+ */
+static void GIF_Index_Compact(GIF_IndexCtx * ctx, Uint32 n) {
+  Uint8 used[GIF_INDEX_NCOL];
+  Uint8 remap[GIF_INDEX_NCOL];
+  Uint32 i;
+  Uint16 k;
+  
+  memset(used, 0, sizeof used);
+  for (i = 0; i < n; i++)
+    used[ctx->canvas[i]] = 1;
+  if (ctx->saved)
+    for (i = 0; i < n; i++)
+      used[ctx->save[i]] = 1;
+  
+  k = GIF_INDEX_TRANSP + 1;
+  remap[GIF_INDEX_TRANSP] = GIF_INDEX_TRANSP;
+  for (i = GIF_INDEX_TRANSP + 1; i < ctx->npal; i++) {
+    if (used[i]) {
+      ctx->pal[k] = ctx->pal[i];
+      remap[i] = k++;
+    }
+  }
+  
+  if (k == ctx->npal)
+    return;
+  
+  ctx->npal = k;
+  ctx->dirty = 1;
+  
+  for (i = 0; i < n; i++)
+    ctx->canvas[i] = remap[ctx->canvas[i]];
+  if (ctx->saved)
+    for (i = 0; i < n; i++)
+      ctx->save[i] = remap[ctx->save[i]];
+}
+
+/* Build the translation from the frame palette to the canvas palette.
+ * Return -1 if the colors of the frame and the canvas don't fit in 256.
+ */
+static Sint8 GIF_Index_MapPalette(GIF_IndexCtx * ctx, GIF_Image * img,
+                                  Uint8 * map, Uint32 n) {
+  GIF_Color cols[GIF_INDEX_NCOL];
+  Uint8 used[GIF_INDEX_NCOL];
+  Uint32 i, sz;
+  Uint16 missing;
+  int k;
+  
+  /* Indices past the table are legal, their color is black */
+  memset(cols, 0, sizeof cols);
+  memcpy(cols, img->lcolTable,
+         (img->nlcol < GIF_INDEX_NCOL ? img->nlcol : GIF_INDEX_NCOL) *
+         sizeof *cols);
+  
+  memset(used, 0, sizeof used);
+  sz = (Uint32)img->imgWidth * img->imgHeight;
+  for (i = 0; i < sz; i++)
+    used[img->data[i] & 0xFF] = 1;
+  
+  if (img->transpColor)
+    used[img->transpColorIdx] = 0;
+  
+  missing = 0;
+  for (i = 0; i < GIF_INDEX_NCOL; i++) {
+    if (used[i] && GIF_Index_FindColor(ctx, &cols[i]) < 0)
+      missing++;
+  }
+  
+  if (ctx->npal + missing > GIF_INDEX_NCOL) {
+    GIF_Index_Compact(ctx, n);
+    
+    missing = 0;
+    for (i = 0; i < GIF_INDEX_NCOL; i++) {
+      if (used[i] && GIF_Index_FindColor(ctx, &cols[i]) < 0)
+        missing++;
+    }
+    
+    if (ctx->npal + missing > GIF_INDEX_NCOL)
+      return -1;
+  }
+  
+  for (i = 0; i < GIF_INDEX_NCOL; i++) {
+    if (!used[i])
+      continue;
+    
+    k = GIF_Index_FindColor(ctx, &cols[i]);
+    if (k < 0) {
+      k = ctx->npal++;
+      ctx->pal[k] = cols[i];
+      ctx->dirty = 1;
+    }
+    map[i] = k;
+  }
+  
+  return 0;
+}
+
+
+
+/* #pragma mark Compositing */
+
+/* Draw the frame on the canvas, clipped to the logical screen */
+static void GIF_Index_Draw(GIF_IndexCtx * ctx, GIF_Image * img, Uint8 * map,
+                           Uint16 w, Uint16 h) {
+  Uint8 start[4] = { 0, 4, 2, 1 };
+  Uint8 off[4] = { 8, 8, 4, 2 };
+  Uint32 k, l, y, pass;
+  Uint32 x0, x1;
+  Uint16 * src;
+  Uint8 * dst;
+  
+  x0 = img->imgLftPos;
+  x1 = x0 + img->imgWidth;
+  if (x1 > w)
+    x1 = w;
+  
+  pass = 0;
+  y = 0;
+  for (k = 0; k < img->imgHeight; k++) {
+    src = img->data + k * img->imgWidth;
+    
+    if (x0 < x1 && img->imgTopPos + y < h) {
+      dst = ctx->canvas + (img->imgTopPos + y) * w;
+      
+      for (l = x0; l < x1; l++, src++) {
+        if (!img->transpColor || *src != img->transpColorIdx)
+          dst[l] = map[*src & 0xFF];
+      }
+    }
+    
+    /* Next row, de-interlaced : 4 passes starting at 'start' by 'off' */
+    if (img->interlace) {
+      y += off[pass];
+      while (y >= img->imgHeight && ++pass < 4)
+        y = start[pass];
+    }
+    else
+      y++;
+  }
+}
+
+/* Apply the disposal method of the frame to the canvas */
+static void GIF_Index_Dispose(GIF_IndexCtx * ctx, GIF_Image * img,
+                              Uint16 w, Uint16 h) {
+  Uint32 x0, x1, y, y1;
+  
+  x0 = img->imgLftPos;
+  x1 = x0 + img->imgWidth;
+  y1 = img->imgTopPos + img->imgHeight;
+  if (x1 > w)
+    x1 = w;
+  if (y1 > h)
+    y1 = h;
+  if (x0 >= x1)
+    return;
+  
+  for (y = img->imgTopPos; y < y1; y++) {
+    switch (img->dispMeth) {
+      case 2:
+        memset(ctx->canvas + y * w + x0, GIF_INDEX_TRANSP, x1 - x0);
+        break;
+      
+      case 3:
+        memcpy(ctx->canvas + y * w + x0, ctx->save + y * w + x0, x1 - x0);
+        break;
+      
+      default:
+        return;
+    }
+  }
+}
+
+/* Store the canvas as the frame i */
+static Sint8 GIF_Index_Snapshot(GIF_IndexStore * store, GIF_IndexCtx * ctx,
+                                Uint32 i) {
+  GIF_IndexFrame * frm = &store->frames[i];
+  GIF_IndexFrame * prv;
+  Uint32 ** pals;
+  Uint8 * src;
+  Uint32 n = (Uint32)store->w * store->h;
+  Uint32 k;
+  
+  if (ctx->dirty || store->npals == 0) {
+    pals = realloc(store->pals, (store->npals + 1) * sizeof *store->pals);
+    if (pals == NULL)
+      return -1;
+    store->pals = pals;
+    
+    pals[store->npals] = malloc(GIF_INDEX_NCOL * sizeof **pals);
+    if (pals[store->npals] == NULL)
+      return -1;
+    /* Converted once, for every frame that shares it */
+    pals[store->npals][GIF_INDEX_TRANSP] = GIF_TRANSPARENT;
+    for (k = GIF_INDEX_TRANSP + 1; k < GIF_INDEX_NCOL; k++)
+      pals[store->npals][k] = GIF_RGB(ctx->pal[k].r, ctx->pal[k].g,
+                                      ctx->pal[k].b);
+    store->npals++;
+    ctx->dirty = 0;
+  }
+  frm->pal = store->pals[store->npals - 1];
+  
+  if (store->flags & GIF_LOAD_DELTA) {
+    for (k = 0; k < n; k++)
+      ctx->prev[k] ^= ctx->canvas[k];
+    frm->sz = GIF_Index_RLEEncode(ctx->tmp, ctx->prev, n);
+    memcpy(ctx->prev, ctx->canvas, n);
+  }
+  else if (store->flags & GIF_LOAD_RLE) {
+    frm->sz = GIF_Index_RLEEncode(ctx->tmp, ctx->canvas, n);
+  }
+  else {
+    frm->sz = n;
+  }
+  
+  src = store->flags & GIF_LOAD_RLE ? ctx->tmp : ctx->canvas;
+  frm->hash = GIF_Hash(GIF_HASH_SEED, src, frm->sz);
+  
+  /* Identical frames share their plane, deltas depend on their position */
+  if (!(store->flags & GIF_LOAD_DELTA)) {
+    for (k = 0; k < i; k++) {
+      prv = &store->frames[k];
+      
+      if (prv->hash == frm->hash && prv->sz == frm->sz && prv->pal == frm->pal &&
+          memcmp(prv->data, src, frm->sz) == 0) {
+        frm->data = prv->data;
+        frm->shared = 1;
+        return 0;
+      }
+    }
+  }
+  
+  frm->data = malloc(frm->sz);
+  if (frm->data == NULL)
+    return -1;
+  memcpy(frm->data, src, frm->sz);
+  
+  return 0;
+}
+
+/* Composite all the raw images as index planes.
+ * Return NULL if the frames can't be represented with 256 colors.
+ */
+GIF_IndexStore * GIF_Index_Render(GIF_Raw * raw, Uint32 flags) {
+  GIF_IndexStore * store;
+  GIF_IndexCtx ctx;
+  GIF_Image * img;
+  Uint8 map[GIF_INDEX_NCOL];
+  Uint32 i, n;
+  Sint8 ret;
+  
+  /* Delta frames are pointless without run-length encoding */
+  if (flags & GIF_LOAD_DELTA)
+    flags |= GIF_LOAD_RLE;
+  
+  store = calloc(1, sizeof *store);
+  if (store == NULL)
+    return NULL;
+  
+  store->flags = flags;
+  store->w = raw->w;
+  store->h = raw->h;
+  store->cur = -1;
+  store->nframes = raw->i;
+  
+  n = (Uint32)raw->w * raw->h;
+  
+  memset(&ctx, 0, sizeof ctx);
+  ctx.npal = GIF_INDEX_TRANSP + 1;
+  ctx.canvas = calloc(n + 1, sizeof *ctx.canvas);
+  ctx.save = malloc((n + 1) * sizeof *ctx.save);
+  ctx.prev = calloc(n + 1, sizeof *ctx.prev);
+  ctx.tmp = malloc(n + n / GIF_INDEX_LITMAX + 2);
+  store->frames = calloc(raw->i + 1, sizeof *store->frames);
+  store->plane = calloc(n + 1, sizeof *store->plane);
+  store->sfc = GIF_CreateRGBSurface(raw->w, raw->h);
+  
+  ret = 0;
+  if (ctx.canvas == NULL || ctx.save == NULL || ctx.prev == NULL ||
+      ctx.tmp == NULL || store->frames == NULL || store->plane == NULL ||
+      store->sfc == NULL)
+    ret = -1;
+  
+  for (i = 0; ret == 0 && i < raw->i; i++) {
+    img = &raw->img[i];
+    
+    ctx.saved = img->dispMeth == 3;
+    if (ctx.saved)
+      memcpy(ctx.save, ctx.canvas, n);
+    
+    /* Drawing an image again over itself doesn't change the canvas */
+    if (i == 0 || raw->img[i - 1].dispMeth == 2 ||
+        raw->img[i - 1].dispMeth == 3 ||
+        !GIF_SameImage(img, &raw->img[i - 1])) {
+      ret = GIF_Index_MapPalette(&ctx, img, map, n);
+      if (ret < 0)
+        break;
+      
+      GIF_Index_Draw(&ctx, img, map, raw->w, raw->h);
+    }
+    
+    ret = GIF_Index_Snapshot(store, &ctx, i);
+    
+    GIF_Index_Dispose(&ctx, img, raw->w, raw->h);
+  }
+  
+  free(ctx.canvas);
+  free(ctx.save);
+  free(ctx.prev);
+  free(ctx.tmp);
+  
+  if (ret < 0) {
+    GIF_Index_Free(store);
+    return NULL;
+  }
+  
+  return store;
+}
+
+
+
+/* #pragma mark Presentation */
+
+/* Expand the index plane to the presentation surface */
+static void GIF_Index_Expand(GIF_IndexStore * store, const Uint8 * plane,
+                             const Uint32 * lut) {
+  SDL_Surface * sfc = store->sfc;
+  Uint32 * dst;
+  Uint32 x, y;
+  
+  if (SDL_MUSTLOCK(sfc))
+    SDL_LockSurface(sfc);
+  
+  for (y = 0; y < store->h; y++, plane += store->w) {
+    dst = GIF_ROW(sfc, y);
+    for (x = 0; x < store->w; x++)
+      dst[x] = lut[plane[x]];
+  }
+  
+  if (SDL_MUSTLOCK(sfc))
+    SDL_UnlockSurface(sfc);
+  
+  SDL_SetColorKey(sfc, GIF_COLORKEY, GIF_TRANSPARENT);
+}
+
+SDL_Surface * GIF_Index_GetFrame(GIF_IndexStore * store, Uint32 i) {
+  const Uint8 * plane = store->plane;
+  Uint32 k;
+  
+  if (i >= store->nframes || (Sint32)i == store->cur)
+    return store->sfc;
+  
+  if (store->flags & GIF_LOAD_DELTA) {
+    /* Replay the deltas from the first frame when going backward */
+    if (store->cur < 0 || (Sint32)i < store->cur) {
+      memset(store->plane, 0, (Uint32)store->w * store->h);
+      store->cur = -1;
+    }
+    for (k = store->cur + 1; k <= i; k++)
+      GIF_Index_RLEDecode(store->plane, store->frames[k].data,
+                          store->frames[k].sz, 1);
+  }
+  else if (store->flags & GIF_LOAD_RLE) {
+    GIF_Index_RLEDecode(store->plane, store->frames[i].data,
+                        store->frames[i].sz, 0);
+  }
+  else {
+    plane = store->frames[i].data;
+  }
+  
+  GIF_Index_Expand(store, plane, store->frames[i].pal);
+  store->cur = i;
+  
+  return store->sfc;
+}
+
+/* Add the bytes held by the store to 'mem', 'total' only gets the tables */
+void GIF_Index_Memory(GIF_IndexStore * store, GIF_Memory * mem) {
+  Uint32 i;
+  
+  for (i = 0; i < store->nframes; i++)
+    if (!store->frames[i].shared)
+      mem->indexed += store->frames[i].sz;
+  mem->indexed += (Uint32)store->w * store->h + 1;
+  
+  mem->palettes += (Uint64)store->npals * GIF_INDEX_NCOL * sizeof **store->pals;
+  mem->frames += (Uint64)store->sfc->pitch * store->sfc->h;
+  mem->total += sizeof *store + (store->nframes + 1) * sizeof *store->frames +
+                store->npals * sizeof *store->pals;
+}
+
+void GIF_Index_Free(GIF_IndexStore * store) {
+  Uint32 i;
+  
+  if (store == NULL)
+    return;
+  
+  if (store->frames != NULL) {
+    for (i = 0; i < store->nframes; i++) {
+      if (!store->frames[i].shared)
+        free(store->frames[i].data);
+    }
+    free(store->frames);
+  }
+  
+  for (i = 0; i < store->npals; i++)
+    free(store->pals[i]);
+  free(store->pals);
+  
+  free(store->plane);
+  if (store->sfc != NULL)
+    SDL_FreeSurface(store->sfc);
+  free(store);
+}
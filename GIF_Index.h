@@ -0,0 +1,38 @@
+#ifndef GIF_INDEX_H
+#define GIF_INDEX_H
+
+#include "GIF_Struct.h"
+
+/* A composited frame kept as an 8-bit index plane.
+ * Index 0 is reserved for transparent pixels, the others refer to 'pal',
+ * kept in the layout of the surfaces so that it's ready to store.
+ */
+typedef struct {
+  Uint8 * data;       /* Index plane, raw or run-length encoded */
+  Uint32 sz;          /* Size of 'data' (bytes) */
+  Uint32 * pal;       /* Palette of the frame, shared between frames */
+  Uint32 hash;        /* Hash of 'data' */
+  Uint8 shared;       /* 'data' belongs to a previous frame */
+} GIF_IndexFrame;
+
+typedef struct GIF_IndexStore_s {
+  GIF_IndexFrame * frames;
+  Uint32 nframes;
+  Uint32 flags;       /* GIF_LOAD_* flags */
+  Uint16 w;
+  Uint16 h;
+  
+  Uint32 ** pals;     /* Every palette referenced by 'frames' */
+  Uint32 npals;
+  
+  Uint8 * plane;      /* Index plane of the presented frame */
+  SDL_Surface * sfc;  /* Presentation surface */
+  Sint32 cur;         /* Frame held in 'plane' and 'sfc', -1 if none */
+} GIF_IndexStore;
+
+GIF_IndexStore * GIF_Index_Render(GIF_Raw * raw, Uint32 flags);
+SDL_Surface * GIF_Index_GetFrame(GIF_IndexStore * store, Uint32 i);
+void GIF_Index_Memory(GIF_IndexStore * store, GIF_Memory * mem);
+void GIF_Index_Free(GIF_IndexStore * store);
+
+#endif
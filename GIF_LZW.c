@@ -28,10 +28,8 @@ typedef struct {
 } GIF_LZW_Dic;
 
 typedef struct {
-  Uint8 * buf;
-  Uint8 sz;       /* Size of the buffer */
-  Uint16 i;       /* Index in the buffer */
-  Uint8 bit;      /* Current bit */
+  Uint8 * buf;    /* Data of the sub-blocks, followed by 4 null bytes */
+  Uint32 sz;      /* Size of the data */
 } GIF_LZW_Buf;
 
 
@@ -65,42 +63,6 @@ int GIF_LZW_DicCheckCdeSize(GIF_LZW_Dic * dic) {
   return 0;
 }
 
-int GIF_LZW_DicAddCode(GIF_LZW_Dic * dic, Uint16 c, Uint16 oldCode) {
-  if (dic->i >= GIF_LZW_DICSIZE) {
-    fprintf(stderr, "GIF_LZW_DicAddCode : Table full.\n");
-    return -1;
-  }
-  
-  dic->dic[dic->i].c = c;
-  dic->dic[dic->i].i = oldCode;
-  dic->i++;
-  
-  return 0;
-}
-
-Uint16 GIF_LZW_DicGetTranslation(Uint16 * s, GIF_LZW_Dic * dic, Uint16 code) {
-  Uint16 i = 0;
-  
-  if (code > dic->endOfInfo) {
-    i = GIF_LZW_DicGetTranslation(s, dic, dic->dic[code].i);
-    s[i] = dic->dic[code].c;
-  }
-  else
-    s[i] = code;
-  
-  return i + 1;
-}
-
-Uint16 * GIF_LZW_DicStrOutput(Uint16 * p, Uint16 * s, Uint16 n) {
-  
-  while (n != 0) {
-    *p++ = *s++;
-    n--;
-  }
-  
-  return p;
-}
-
 int GIF_LZW_SetBuffer(GIF_LZW_Buf * buf) {
 //  Uint8 tmp[256];
 //  long pos;
@@ -127,7 +89,7 @@ int GIF_LZW_SetBuffer(GIF_LZW_Buf * buf) {
 //      return -1;
   }
   
-  buf->buf = malloc((sz + 1) * sizeof *buf->buf);
+  buf->buf = malloc((sz + 4) * sizeof *buf->buf);
   if (buf->buf == NULL) {
     perror("GIF_LZW_SetBuffer : malloc");
     return -1;
@@ -158,8 +120,8 @@ int GIF_LZW_SetBuffer(GIF_LZW_Buf * buf) {
   
   pdata++;
   
-  buf->bit = 0;
-  buf->i = 0;
+  memset(buf->buf + sz, 0, 4);
+  buf->sz = sz;
   
   return 0;
 }
@@ -169,115 +131,578 @@ int GIF_LZW_ClearBuffer(GIF_LZW_Buf * buf) {
   return 0;
 }
 
-/* Thanks 17o2!! */
-Uint16 GIF_LZW_GetBits(GIF_LZW_Buf * buf, unsigned nBits) {
-	Uint16	ret = 0;
-	Uint32	i;
-	Uint8	mask;
-	Uint16	maskd;
-  
-  //printf("%02X %02X / nbits = %d / ", buf->buf[buf->i], buf->buf[buf->i+1], nBits);
-  
-	mask = 1 << buf->bit;
-	maskd = 1;
-	for (i = 0; i < nBits; i++)
-	{
-		ret |= (buf->buf[buf->i] & mask ? maskd : 0);
-		maskd <<= 1;
-		mask <<= 1;
-		if (mask == 0)
-		{
-			mask = 1;
-			buf->i++;
-		}
-	}
-	buf->bit = (buf->bit + nBits) & 7;
-  
-  //printf("code = %x\n", ret);
-  
-	return (ret);
+/* #pragma mark Kernels */
+
+/* Table of the decoding kernels. A string is written straight in the
+ * output from its last character : 'len' gives where it ends, 'pre' and
+ * 'suf' are followed back to its first character.
+ */
+typedef struct {
+  Uint16 pre[GIF_LZW_DICSIZE];  /* String without its last character */
+  Uint16 suf[GIF_LZW_DICSIZE];  /* Last character */
+  Uint16 len[GIF_LZW_DICSIZE];  /* Length of the string */
+} GIF_LZW_Table;
+
+typedef Sint8 (*GIF_LZW_Kernel)(GIF_LZW_Table * t, const Uint8 * in,
+                                Uint32 sz, Uint16 * out, Uint32 n,
+                                Uint8 minCdeSz);
+
+#define GIF_LZW_LOAD32(p) \
+  ((Uint32)(p)[0] | (Uint32)(p)[1] << 8 | (Uint32)(p)[2] << 16 | \
+   (Uint32)(p)[3] << 24)
+
+/* Next code of W bits in 'code', the end of the data ends the image */
+#define GIF_LZW_FETCH(W)                                                   \
+  if (nbits < (Uint32)(W)) {                                               \
+    if (pos >= sz)                                                         \
+      goto end;                                                            \
+    acc |= (Uint64)GIF_LZW_LOAD32(in + pos) << nbits;                      \
+    k = sz - pos < 4 ? sz - pos : 4;                                       \
+    pos += k;                                                              \
+    nbits += 8 * k;                                                        \
+    if (nbits < (Uint32)(W))                                               \
+      goto end;                                                            \
+  }                                                                        \
+  code = acc & ((1 << (W)) - 1);                                           \
+  acc >>= (W);                                                             \
+  nbits -= (W)
+
+/* Codes of W bits until the table reaches 2**W entries, then go to the
+ * segment of the next width. Without a clear code, the table stays full
+ * at 12 bits.
+ */
+#define GIF_LZW_SEGMENT(W, NEXT)                                           \
+  seg##W:                                                                  \
+  while (1) {                                                              \
+    GIF_LZW_FETCH(W);                                                      \
+                                                                           \
+    if (code < next) {                                                     \
+      if (code == clear)                                                   \
+        goto reset;                                                        \
+      if (code == eoi)                                                     \
+        goto end;                                                          \
+      c = code;                                                            \
+    }                                                                      \
+    /* Not in the table yet : previous string + its first character */     \
+    else if (code == next && next < GIF_LZW_DICSIZE)                       \
+      c = old;                                                             \
+    else                                                                   \
+      goto bad;                                                            \
+                                                                           \
+    l = t->len[c] + (c != code);                                           \
+    if (l > n - o)                                                         \
+      goto tail;                                                           \
+                                                                           \
+    q = out + o + t->len[c];                                               \
+    for (i = t->len[c]; i != 0; i--) {                                     \
+      *--q = t->suf[c];                                                    \
+      c = t->pre[c];                                                       \
+    }                                                                      \
+    if (code == next)                                                      \
+      out[o + l - 1] = out[o];                                             \
+                                                                           \
+    if (next < GIF_LZW_DICSIZE) {                                          \
+      t->pre[next] = old;                                                  \
+      t->suf[next] = out[o];                                               \
+      t->len[next] = t->len[old] + 1;                                      \
+      next++;                                                              \
+    }                                                                      \
+    o += l;                                                                \
+    old = code;                                                            \
+                                                                           \
+    if ((W) < 12 && next >= 1 << (W))                                      \
+      goto NEXT;                                                           \
+  }
+
+/* A kernel for the minimum code size MIN. With a constant, the clear code,
+ * the end code and the first width are constants too.
+ * Return 0, -1 on an unknown code.
+ */
+#define GIF_LZW_KERNEL(NAME, MIN)                                          \
+static Sint8 NAME(GIF_LZW_Table * t, const Uint8 * in, Uint32 sz,          \
+                  Uint16 * out, Uint32 n, Uint8 minCdeSz) {                \
+  const Uint16 clear = 1 << (MIN);                                         \
+  const Uint16 eoi = clear + 1;                                            \
+  Uint16 s[GIF_LZW_DICSIZE + 1];                                           \
+  Uint64 acc = 0;                                                          \
+  Uint32 nbits = 0;                                                        \
+  Uint32 pos = 0;                                                          \
+  Uint32 o = 0;                                                            \
+  Uint32 i, k;                                                             \
+  Uint16 code, c, l;                                                       \
+  Uint16 old = 0;                                                          \
+  Uint16 next = clear + 2;                                                 \
+  Uint16 * q;                                                              \
+                                                                           \
+  (void)minCdeSz;                                                          \
+  for (i = 0; i < clear; i++) {                                            \
+    t->suf[i] = i;                                                         \
+    t->len[i] = 1;                                                         \
+  }                                                                        \
+                                                                           \
+  GIF_LZW_FETCH((MIN) + 1);                                                \
+  if (code != clear) {                                                     \
+    fprintf(stderr, "GIF_LZW_GetData : First code must be a clear code.\n");\
+    return -1;                                                             \
+  }                                                                        \
+                                                                           \
+  /* After a clear code : a root code, nothing is added */                 \
+  reset:                                                                   \
+  next = clear + 2;                                                        \
+  GIF_LZW_FETCH((MIN) + 1);                                                \
+  if (code == clear)                                                       \
+    goto reset;                                                            \
+  if (code == eoi)                                                         \
+    goto end;                                                              \
+  if (code > clear)                                                        \
+    goto bad;                                                              \
+  if (o == n)                                                              \
+    goto end;                                                              \
+  out[o++] = code;                                                         \
+  old = code;                                                              \
+                                                                           \
+  switch ((MIN) + 1) {                                                     \
+    case 2: goto seg2;                                                     \
+    case 3: goto seg3;                                                     \
+    case 4: goto seg4;                                                     \
+    case 5: goto seg5;                                                     \
+    case 6: goto seg6;                                                     \
+    case 7: goto seg7;                                                     \
+    case 8: goto seg8;                                                     \
+    case 9: goto seg9;                                                     \
+    case 10: goto seg10;                                                   \
+    case 11: goto seg11;                                                   \
+    default: goto seg12;                                                   \
+  }                                                                        \
+                                                                           \
+  GIF_LZW_SEGMENT(2, seg3)                                                 \
+  GIF_LZW_SEGMENT(3, seg4)                                                 \
+  GIF_LZW_SEGMENT(4, seg5)                                                 \
+  GIF_LZW_SEGMENT(5, seg6)                                                 \
+  GIF_LZW_SEGMENT(6, seg7)                                                 \
+  GIF_LZW_SEGMENT(7, seg8)                                                 \
+  GIF_LZW_SEGMENT(8, seg9)                                                 \
+  GIF_LZW_SEGMENT(9, seg10)                                                \
+  GIF_LZW_SEGMENT(10, seg11)                                               \
+  GIF_LZW_SEGMENT(11, seg12)                                               \
+  GIF_LZW_SEGMENT(12, seg12)                                               \
+                                                                           \
+  /* The string goes past the image : only its beginning is kept */        \
+  tail:                                                                    \
+  for (i = t->len[c]; i != 0; i--) {                                       \
+    s[i - 1] = t->suf[c];                                                  \
+    c = t->pre[c];                                                         \
+  }                                                                        \
+  if (code == next)                                                        \
+    s[l - 1] = s[0];                                                       \
+  memcpy(out + o, s, (n - o) * sizeof *out);                               \
+  return 0;                                                                \
+                                                                           \
+  bad:                                                                     \
+  fprintf(stderr, "GIF_LZW_GetData : Unknown code.\n");                    \
+  return -1;                                                               \
+                                                                           \
+  /* Data ended before the image : the missing pixels are index 0 */       \
+  end:                                                                     \
+  memset(out + o, 0, (n - o) * sizeof *out);                               \
+  return 0;                                                                \
 }
 
+GIF_LZW_KERNEL(GIF_LZW_Decode2, 2)
+GIF_LZW_KERNEL(GIF_LZW_Decode3, 3)
+GIF_LZW_KERNEL(GIF_LZW_Decode4, 4)
+GIF_LZW_KERNEL(GIF_LZW_Decode5, 5)
+GIF_LZW_KERNEL(GIF_LZW_Decode6, 6)
+GIF_LZW_KERNEL(GIF_LZW_Decode7, 7)
+GIF_LZW_KERNEL(GIF_LZW_Decode8, 8)
+GIF_LZW_KERNEL(GIF_LZW_DecodeAny, minCdeSz)
+
+static const GIF_LZW_Kernel GIF_LZW_Kernels[] = {
+  GIF_LZW_Decode2, GIF_LZW_Decode3, GIF_LZW_Decode4, GIF_LZW_Decode5,
+  GIF_LZW_Decode6, GIF_LZW_Decode7, GIF_LZW_Decode8
+};
+
+
 
 int GIF_LZW_GetData(GIF_Image * img) {
-  GIF_LZW_Dic dic;
+  GIF_LZW_Table * tab;
+  GIF_LZW_Kernel f;
   GIF_LZW_Buf buf;
-  Uint16 oldCode;
-  Uint16 code;
-  Uint8 tmp;
-  Uint16 * p;
-  Uint16 s[GIF_LZW_DICSIZE + 1];
-  Uint16 n;
+  Uint32 n = (Uint32)img->imgHeight * img->imgWidth;
+  Uint8 minCdeSz;
+  Sint8 ret;
   
-//  printf("w : %d\n", img->imgWidth);
-//  printf("h : %d\n", img->imgHeight);
-//  printf("nbpix : %d\n", img->imgWidth * img->imgHeight);
-  
-  img->data = malloc(img->imgHeight * img->imgWidth * sizeof *img->data);
+  img->data = malloc(n * sizeof *img->data);
   if (img->data == NULL)
     return -1;
   
   /* Read the minimum code size */
-  tmp = *pdata++;
+  minCdeSz = *pdata++;
+  if (minCdeSz < 1 || minCdeSz > 11) {
+    fprintf(stderr, "GIF_LZW_GetData : Bad code size.\n");
+    free(img->data);
+    img->data = NULL;
+    return -1;
+  }
+  
+  tab = malloc(sizeof *tab);
+  if (tab == NULL || GIF_LZW_SetBuffer(&buf) < 0) {
+    free(tab);
+    free(img->data);
+    img->data = NULL;
+    return -1;
+  }
+  
+  /* The kernel is chosen once for the image */
+  if (minCdeSz >= 2 && minCdeSz <= 8)
+    f = GIF_LZW_Kernels[minCdeSz - 2];
+  else
+    f = GIF_LZW_DecodeAny;
+  ret = f(tab, buf.buf, buf.sz, img->data, n, minCdeSz);
+  
+  GIF_LZW_ClearBuffer(&buf);
+  free(tab);
+  
+  /* The image isn't kept, nothing else frees its data */
+  if (ret < 0) {
+    free(img->data);
+    img->data = NULL;
+  }
+  
+  return ret;
+}
+
+
+
+
+/* #pragma mark Stream */
+
+/* Incremental decoder : the compressed bytes can be pushed in pieces of
+ * any size, the state is kept between the calls and each row is given to
+ * 'f' as soon as it is complete.
+ */
+struct GIF_LZW_Stream_s {
+  GIF_LZW_Dic dic;
+  
+  Uint32 acc;         /* Bit accumulator */
+  Uint8 nbits;        /* Number of bits in 'acc' */
+  Sint32 oldCode;     /* Previous code, -1 after a clear code */
+  Uint8 done;         /* End of Information reached */
+  
+  Uint8 * row;        /* Row being decoded */
+  Uint16 w;           /* Size of a row */
+  Uint16 x;           /* Position in the row */
+  Uint16 y;           /* Rows already given to 'f' */
+  Uint16 h;           /* Number of rows */
+  Uint16 rowSz;       /* Allocated size of 'row' */
   
-  GIF_LZW_DicInit(&dic, tmp);
-  GIF_LZW_SetBuffer(&buf);
+  GIF_LZW_RowFunc f;
+  void * data;
   
-  p = img->data;
+  Uint8 s[GIF_LZW_DICSIZE + 1]; /* Translation of a code, reversed */
+};
+
+GIF_LZW_Stream * GIF_LZW_StreamCreate(void) {
+  GIF_LZW_Stream * st;
   
-  code = GIF_LZW_GetBits(&buf, dic.cdeSz);
-  if (code != dic.clearCode) {
-    fprintf(stderr, "GIF_LZW_GetData : First code must be a clear code.\n");
-    GIF_LZW_ClearBuffer(&buf);
+  st = malloc(sizeof *st);
+  if (st == NULL) {
+    perror("GIF_LZW_StreamCreate : malloc");
+    return NULL;
+  }
+  
+  st->row = NULL;
+  st->rowSz = 0;
+  st->done = 1;
+  
+  return st;
+}
+
+void GIF_LZW_StreamFree(GIF_LZW_Stream * st) {
+  if (st == NULL)
+    return;
+  
+  free(st->row);
+  free(st);
+}
+
+int GIF_LZW_StreamInit(GIF_LZW_Stream * st, Uint8 minCdeSz, Uint16 w, Uint16 h,
+                       GIF_LZW_RowFunc f, void * data) {
+  Uint8 * row;
+  
+  if (minCdeSz < 1 || minCdeSz > 11) {
+    fprintf(stderr, "GIF_LZW_StreamInit : Bad code size.\n");
     return -1;
   }
   
-  /*oldCode = GIF_LZW_GetBits(&buf, dic.cdeSz);
-  n = GIF_LZW_DicGetTranslation(s, &dic, oldCode);
-  pdata = GIF_LZW_DicStrOutput(pdata, s, n);*/
+  if (w > st->rowSz) {
+    row = realloc(st->row, w);
+    if (row == NULL) {
+      perror("GIF_LZW_StreamInit : realloc");
+      return -1;
+    }
+    st->row = row;
+    st->rowSz = w;
+  }
   
-  goto reset;
+  GIF_LZW_DicInit(&st->dic, minCdeSz);
+  st->acc = 0;
+  st->nbits = 0;
+  st->oldCode = -1;
+  st->done = 0;
+  st->w = w;
+  st->h = h;
+  st->x = 0;
+  st->y = 0;
+  st->f = f;
+  st->data = data;
+  
+  return 0;
+}
+
+/* Write the n bytes of the reversed string 's' in the rows */
+static void GIF_LZW_StreamOutput(GIF_LZW_Stream * st, Uint16 n) {
+  Uint8 * s = st->s + n;
+  Uint16 k;
+  
+  while (n != 0 && st->y < st->h) {
+    k = st->w - st->x;
+    if (k > n)
+      k = n;
+    n -= k;
+    
+    while (k != 0) {
+      st->row[st->x++] = *--s;
+      k--;
+    }
+    
+    if (st->x == st->w) {
+      st->f(st->data, st->y, st->row);
+      st->x = 0;
+      st->y++;
+    }
+  }
+}
+
+/* Reversed translation of a code in 's', return its length */
+static Uint16 GIF_LZW_StreamTranslate(GIF_LZW_Stream * st, Uint16 code) {
+  Uint16 n = 0;
+  
+  while (code > st->dic.endOfInfo) {
+    st->s[n++] = st->dic.dic[code].c;
+    code = st->dic.dic[code].i;
+  }
+  st->s[n++] = code;
+  
+  return n;
+}
+
+/* Return 1 once the image is complete, -1 on error, 0 otherwise */
+int GIF_LZW_StreamPush(GIF_LZW_Stream * st, const Uint8 * p, Uint32 n) {
+  GIF_LZW_Dic * dic = &st->dic;
+  Uint16 code;
+  Uint16 len;
+  Uint8 c;
+  
+  if (st->done)
+    return 1;
   
   while (1) {
-    //printf("%d / ", dic.i);
-    code = GIF_LZW_GetBits(&buf, dic.cdeSz);
+    while (st->nbits < dic->cdeSz) {
+      if (n == 0)
+        return 0;
+      st->acc |= (Uint32)*p++ << st->nbits;
+      st->nbits += 8;
+      n--;
+    }
+    
+    code = st->acc & ((1 << dic->cdeSz) - 1);
+    st->acc >>= dic->cdeSz;
+    st->nbits -= dic->cdeSz;
     
-    if (code == dic.clearCode) reset: {
-      GIF_LZW_DicReset(&dic);
-      code = GIF_LZW_GetBits(&buf, dic.cdeSz);
-      n = GIF_LZW_DicGetTranslation(s, &dic, code);
-      p = GIF_LZW_DicStrOutput(p, s, n);
+    if (code == dic->clearCode) {
+      GIF_LZW_DicReset(dic);
+      st->oldCode = -1;
+      continue;
     }
-    else if (code == dic.endOfInfo) {
-      break;
+    
+    if (code == dic->endOfInfo) {
+      st->done = 1;
+      return 1;
     }
-    else {
-      /* The code is present */
-      if (code < dic.i) {
-        n = GIF_LZW_DicGetTranslation(s, &dic, code);
-      }
-      /* The code is not present */
-      else if (code != dic.i) {
-        fprintf(stderr, "GIF_LZW_GetData : Unkonwn code.\n");
-        GIF_LZW_ClearBuffer(&buf);
+    
+    if (st->oldCode < 0) {
+      if (code > dic->clearCode) {
+        fprintf(stderr, "GIF_LZW_StreamPush : Unknown code.\n");
         return -1;
       }
-      /* Error */
-      else {
-        n = GIF_LZW_DicGetTranslation(s, &dic, oldCode);
-        s[n++] = s[0];
+      st->s[0] = code;
+      GIF_LZW_StreamOutput(st, 1);
+      st->oldCode = code;
+      continue;
+    }
+    
+    /* The code is present */
+    if (code < dic->i) {
+      len = GIF_LZW_StreamTranslate(st, code);
+      c = st->s[len - 1];
+    }
+    /* The code is the next one : previous string + its first character */
+    else if (code == dic->i && dic->i < GIF_LZW_DICSIZE) {
+      len = GIF_LZW_StreamTranslate(st, st->oldCode);
+      c = st->s[len - 1];
+      memmove(st->s + 1, st->s, len);
+      st->s[0] = c;
+      len++;
+    }
+    else {
+      fprintf(stderr, "GIF_LZW_StreamPush : Unknown code.\n");
+      return -1;
+    }
+    
+    GIF_LZW_StreamOutput(st, len);
+    
+    /* A full table stays as is until the next clear code */
+    if (dic->i < GIF_LZW_DICSIZE) {
+      dic->dic[dic->i].c = c;
+      dic->dic[dic->i].i = st->oldCode;
+      dic->i++;
+      GIF_LZW_DicCheckCdeSize(dic);
+    }
+    
+    st->oldCode = code;
+    
+    if (st->y == st->h) {
+      st->done = 1;
+      return 1;
+    }
+  }
+}
+
+
+
+/* #pragma mark Compressor */
+
+enum {
+  GIF_LZW_HASHBITS = 14,
+  GIF_LZW_HASHSIZE = 1 << GIF_LZW_HASHBITS   /* 4x the codes, short probes */
+};
+
+/* Open addressing table of the strings : 'keys' holds (prefix << 8 | c) + 1,
+ * 0 for an empty entry, 'codes' the code of the string.
+ */
+typedef struct {
+  Uint32 keys[GIF_LZW_HASHSIZE];
+  Uint16 codes[GIF_LZW_HASHSIZE];
+} GIF_LZW_Hash;
+
+/* Codes are packed LSB first in a 64 bits accumulator, written 4 bytes
+ * at a time. The accumulator holds less than 32 bits between two codes.
+ */
+#define GIF_LZW_PUT(code) do {                          \
+    acc |= (Uint64)(code) << nbits;                     \
+    nbits += cdeSz;                                     \
+    if (nbits >= 32) {                                  \
+      out[o] = acc;                                     \
+      out[o + 1] = acc >> 8;                            \
+      out[o + 2] = acc >> 16;                           \
+      out[o + 3] = acc >> 24;                           \
+      o += 4;                                           \
+      acc >>= 32;                                       \
+      nbits -= 32;                                      \
+    }                                                   \
+  } while (0)
+
+/* Compress the n indexes of 'idx', all lower than 2**minCdeSz.
+ * Return the code stream (without sub-blocks) and its size in 'sz'.
+ */
+Uint8 * GIF_LZW_Compress(const Uint8 * idx, Uint32 n, Uint8 minCdeSz,
+                         Uint32 * sz) {
+  GIF_LZW_Hash * tab;
+  Uint8 * out;
+  Uint64 acc = 0;
+  Uint32 nbits = 0;
+  Uint32 o = 0;
+  Uint32 i, h, key;
+  Uint16 clearCode, endOfInfo, next, cdeSz, prefix;
+  
+  if (minCdeSz < 2 || minCdeSz > 8) {
+    fprintf(stderr, "GIF_LZW_Compress : Bad code size.\n");
+    return NULL;
+  }
+  
+  /* At most 12 bits per index, plus the clear codes and End of Information */
+  out = malloc(2 * (size_t)n + 16);
+  tab = calloc(1, sizeof *tab);
+  if (out == NULL || tab == NULL) {
+    perror("GIF_LZW_Compress : malloc");
+    free(out);
+    free(tab);
+    return NULL;
+  }
+  
+  clearCode = 1 << minCdeSz;
+  endOfInfo = clearCode + 1;
+  next = clearCode + 2;
+  cdeSz = minCdeSz + 1;
+  
+  GIF_LZW_PUT(clearCode);
+  
+  if (n > 0) {
+    prefix = idx[0];
+    
+    for (i = 1; i < n; i++) {
+      key = ((Uint32)prefix << 8 | idx[i]) + 1;
+      h = (key * 0x9E3779B1) >> (32 - GIF_LZW_HASHBITS);
+      
+      while (tab->keys[h] != 0 && tab->keys[h] != key)
+        h = (h + 1) & (GIF_LZW_HASHSIZE - 1);
+      
+      /* The string goes on */
+      if (tab->keys[h] == key) {
+        prefix = tab->codes[h];
+        continue;
+      }
+      
+      GIF_LZW_PUT(prefix);
+      
+      tab->keys[h] = key;
+      tab->codes[h] = next++;
+      
+      /* The decoder adds its entries one code late : the size grows once
+       * the code following 'next - 1' no longer fits.
+       */
+      if (next == GIF_LZW_DICSIZE) {
+        GIF_LZW_PUT(clearCode);
+        memset(tab->keys, 0, sizeof tab->keys);
+        next = clearCode + 2;
+        cdeSz = minCdeSz + 1;
       }
+      else if (next > (1 << cdeSz))
+        cdeSz++;
       
-      p = GIF_LZW_DicStrOutput(p, s, n);
-      GIF_LZW_DicAddCode(&dic, s[0], oldCode);
-      GIF_LZW_DicCheckCdeSize(&dic);
+      prefix = idx[i];
     }
     
-    oldCode = code;
+    GIF_LZW_PUT(prefix);
+    
+    /* The decoder adds an entry for the last code too */
+    if (next >= (1 << cdeSz) && cdeSz < 12)
+      cdeSz++;
   }
   
-  GIF_LZW_ClearBuffer(&buf);
+  GIF_LZW_PUT(endOfInfo);
   
-  return 0;
+  while (nbits > 0) {
+    out[o++] = acc;
+    acc >>= 8;
+    nbits = nbits > 8 ? nbits - 8 : 0;
+  }
+  
+  free(tab);
+  *sz = o;
+  
+  return out;
 }
 
+#undef GIF_LZW_PUT
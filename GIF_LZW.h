@@ -3,6 +3,20 @@
 
 #include "GIF_Struct.h"
 
+typedef struct GIF_LZW_Stream_s GIF_LZW_Stream;
+
+/* Called with each decoded row, in the order of the data */
+typedef void (*GIF_LZW_RowFunc)(void * data, Uint16 y, const Uint8 * row);
+
 int GIF_LZW_GetData(GIF_Image * img);
 
+GIF_LZW_Stream * GIF_LZW_StreamCreate(void);
+int GIF_LZW_StreamInit(GIF_LZW_Stream * st, Uint8 minCdeSz, Uint16 w, Uint16 h,
+                       GIF_LZW_RowFunc f, void * data);
+int GIF_LZW_StreamPush(GIF_LZW_Stream * st, const Uint8 * p, Uint32 n);
+void GIF_LZW_StreamFree(GIF_LZW_Stream * st);
+
+Uint8 * GIF_LZW_Compress(const Uint8 * idx, Uint32 n, Uint8 minCdeSz,
+                         Uint32 * sz);
+
 #endif
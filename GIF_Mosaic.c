@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Struct.h"
+#include "GIF_Render.h"
+#include "GIF_Mosaic.h"
+
+enum {
+  GIF_MOSAIC_BATCH = 16   /* Tiles per task */
+};
+
+typedef struct {
+  GIF_Surface * gif;
+  Sint16 x;
+  Sint16 y;
+  SDL_Surface * sfc;      /* Frame in the atlas, NULL if none yet */
+  Uint32 i;               /* Its number, when 'sfc' is reused between frames */
+  Uint8 dirty;            /* Redrawn by the last update */
+} GIF_MosaicTile;
+
+typedef struct {
+  GIF_Mosaic * m;
+  Uint32 first;
+  Uint32 n;
+} GIF_MosaicTask;
+
+struct GIF_Mosaic_s {
+  SDL_Surface * atlas;
+  Uint32 bg;
+  GIF_Pool * pool;
+  
+  GIF_MosaicTile * tiles;
+  GIF_MosaicTask * tasks;
+  Uint32 ntiles;
+  Uint32 cap;             /* Allocated entries of 'tiles' */
+};
+
+
+
+GIF_Mosaic * GIF_MosaicCreate(Uint16 w, Uint16 h, Uint32 bg, GIF_Pool * pool) {
+  GIF_Mosaic * m;
+  
+  m = calloc(1, sizeof *m);
+  if (m == NULL) {
+    perror("GIF_MosaicCreate : calloc");
+    return NULL;
+  }
+  
+  m->atlas = GIF_CreateRGBSurface(w, h);
+  if (m->atlas == NULL) {
+    free(m);
+    return NULL;
+  }
+  SDL_FillRect(m->atlas, NULL, bg);
+  
+  m->bg = bg;
+  m->pool = pool;
+  
+  return m;
+}
+
+void GIF_MosaicFree(GIF_Mosaic * m) {
+  if (m == NULL)
+    return;
+  
+  SDL_FreeSurface(m->atlas);
+  free(m->tiles);
+  free(m->tasks);
+  free(m);
+}
+
+SDL_Surface * GIF_MosaicGetSurface(GIF_Mosaic * m) {
+  return m->atlas;
+}
+
+/* Put the animation at (x, y) in the atlas.
+ * Return the number of the tile, -1 on error.
+ */
+int GIF_MosaicAdd(GIF_Mosaic * m, GIF_Surface * gif, Sint16 x, Sint16 y) {
+  GIF_MosaicTile * tiles;
+  GIF_MosaicTask * tasks;
+  Uint32 cap;
+  
+  if (m->ntiles == m->cap) {
+    cap = m->cap == 0 ? 64 : 2 * m->cap;
+    tiles = realloc(m->tiles, cap * sizeof *tiles);
+    if (tiles == NULL) {
+      perror("GIF_MosaicAdd : realloc");
+      return -1;
+    }
+    m->tiles = tiles;
+    
+    tasks = realloc(m->tasks, (cap / GIF_MOSAIC_BATCH + 1) * sizeof *tasks);
+    if (tasks == NULL) {
+      perror("GIF_MosaicAdd : realloc");
+      return -1;
+    }
+    m->tasks = tasks;
+    m->cap = cap;
+  }
+  
+  m->tiles[m->ntiles].gif = gif;
+  m->tiles[m->ntiles].x = x;
+  m->tiles[m->ntiles].y = y;
+  m->tiles[m->ntiles].sfc = NULL;
+  m->tiles[m->ntiles].i = 0;
+  m->tiles[m->ntiles].dirty = 0;
+  
+  return m->ntiles++;
+}
+
+
+
+/* #pragma mark Update */
+
+/* Copy the frame in its tile, the transparent pixels get the background */
+static void GIF_MosaicDraw(GIF_Mosaic * m, GIF_MosaicTile * t) {
+  SDL_Surface * dst = m->atlas;
+  SDL_Surface * src = t->sfc;
+  Sint32 x0, x1, y0, y1, x, y;
+  Uint32 * s;
+  Uint32 * d;
+  
+  x0 = t->x < 0 ? 0 : t->x;
+  y0 = t->y < 0 ? 0 : t->y;
+  x1 = t->x + src->w < dst->w ? t->x + src->w : dst->w;
+  y1 = t->y + src->h < dst->h ? t->y + src->h : dst->h;
+  
+  if (SDL_MUSTLOCK(src))
+    SDL_LockSurface(src);
+  
+  for (y = y0; y < y1; y++) {
+    s = GIF_ROW(src, y - t->y);
+    d = GIF_ROW(dst, y);
+    for (x = x0; x < x1; x++)
+      d[x] = s[x - t->x] == GIF_TRANSPARENT ? m->bg : s[x - t->x];
+  }
+  
+  if (SDL_MUSTLOCK(src))
+    SDL_UnlockSurface(src);
+}
+
+/* Advance the animations of a batch of tiles, redraw the ones that changed */
+static void GIF_MosaicTask_Run(void * data, int worker) {
+  GIF_MosaicTask * task = data;
+  GIF_MosaicTile * t = task->m->tiles + task->first;
+  GIF_MosaicTile * end = t + task->n;
+  SDL_Surface * sfc;
+  Uint32 i;
+  
+  (void)worker;
+  for (; t < end; t++) {
+    t->dirty = 0;
+    sfc = GIF_GetNextFrame(t->gif);
+    if (sfc == NULL)
+      continue;
+    
+    /* The indexed and streamed frames reuse one surface */
+    i = t->gif->store != NULL || t->gif->ring != NULL ? t->gif->i : 0;
+    if (sfc == t->sfc && i == t->i)
+      continue;
+    
+    t->sfc = sfc;
+    t->i = i;
+    t->dirty = 1;
+    GIF_MosaicDraw(task->m, t);
+  }
+}
+
+/* Return the number of tiles redrawn, -1 on error */
+int GIF_MosaicUpdate(GIF_Mosaic * m) {
+  Uint32 ntasks = 0;
+  Uint32 i;
+  int n = 0;
+  
+  for (i = 0; i < m->ntiles; i += GIF_MOSAIC_BATCH) {
+    m->tasks[ntasks].m = m;
+    m->tasks[ntasks].first = i;
+    m->tasks[ntasks].n = m->ntiles - i < GIF_MOSAIC_BATCH ? m->ntiles - i
+                                                          : GIF_MOSAIC_BATCH;
+    ntasks++;
+  }
+  
+  if (m->pool == NULL) {
+    for (i = 0; i < ntasks; i++)
+      GIF_MosaicTask_Run(&m->tasks[i], 0);
+  }
+  else {
+    for (i = 0; i < ntasks; i++) {
+      if (GIF_PoolSubmit(m->pool, GIF_MosaicTask_Run, &m->tasks[i]) < 0) {
+        GIF_PoolWait(m->pool);
+        return -1;
+      }
+    }
+    GIF_PoolWait(m->pool);
+  }
+  
+  for (i = 0; i < m->ntiles; i++)
+    n += m->tiles[i].dirty;
+  
+  return n;
+}
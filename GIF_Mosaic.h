@@ -0,0 +1,25 @@
+#ifndef GIF_MOSAIC_H
+#define GIF_MOSAIC_H
+
+#include "GIF.h"
+#include "GIF_Pool.h"
+
+/* Many animations composited in one atlas surface. Each update advances
+ * every animation and only redraws the tiles whose frame changed, the
+ * tiles are shared between the workers of a pool.
+ * A GIF_Surface is only in one tile (its playback is advanced by the worker
+ * that draws it) and the tiles shouldn't overlap.
+ */
+
+typedef struct GIF_Mosaic_s GIF_Mosaic;
+
+/* 'bg' is shown through the transparent pixels, 0x00RRGGBB.
+ * Without a pool, the tiles are drawn by the calling thread.
+ */
+GIF_Mosaic * GIF_MosaicCreate(Uint16 w, Uint16 h, Uint32 bg, GIF_Pool * pool);
+int GIF_MosaicAdd(GIF_Mosaic * m, GIF_Surface * gif, Sint16 x, Sint16 y);
+int GIF_MosaicUpdate(GIF_Mosaic * m);
+SDL_Surface * GIF_MosaicGetSurface(GIF_Mosaic * m);
+void GIF_MosaicFree(GIF_Mosaic * m);
+
+#endif
@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Optimize.h"
+
+
+/* Canvases are kept with one Uint32 per pixel : the R, G, B, A bytes of
+ * an opaque pixel with A set to 255, or 0 for a transparent pixel, so that
+ * two pixels look the same to the decoder if the words are equal.
+ */
+
+/* [x0, x1[ x [y0, y1[, empty if x0 >= x1 */
+typedef struct {
+  Uint32 x0;
+  Uint32 y0;
+  Uint32 x1;
+  Uint32 y1;
+} GIF_DiffRect;
+
+struct GIF_Optimizer_s {
+  Uint16 w;
+  Uint16 h;
+  Uint32 * base;        /* Canvas before the pending frame */
+  Uint32 * prev;        /* Pending frame, the canvas after it */
+  Uint32 * cur;         /* Frame being pushed */
+  Uint32 nframes;
+  GIF_DiffRect rect;    /* Rectangle of the pending frame */
+  Uint8 * out;          /* Pixels given to the caller */
+};
+
+
+
+static void GIF_RectClear(GIF_DiffRect * r) {
+  r->x0 = r->y0 = 0xFFFFFFFF;
+  r->x1 = r->y1 = 0;
+}
+
+static int GIF_RectEmpty(const GIF_DiffRect * r) {
+  return r->x0 >= r->x1;
+}
+
+static Uint32 GIF_RectArea(const GIF_DiffRect * r) {
+  return GIF_RectEmpty(r) ? 0 : (r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+static void GIF_RectAdd(GIF_DiffRect * r, Uint32 x0, Uint32 x1, Uint32 y) {
+  if (x0 < r->x0) r->x0 = x0;
+  if (x1 > r->x1) r->x1 = x1;
+  if (y < r->y0) r->y0 = y;
+  if (y + 1 > r->y1) r->y1 = y + 1;
+}
+
+static void GIF_RectUnion(GIF_DiffRect * r, const GIF_DiffRect * s) {
+  if (GIF_RectEmpty(s))
+    return;
+  GIF_RectAdd(r, s->x0, s->x1, s->y0);
+  GIF_RectAdd(r, s->x0, s->x1, s->y1 - 1);
+}
+
+/* A frame always has at least one pixel */
+static void GIF_RectMin(GIF_DiffRect * r) {
+  if (GIF_RectEmpty(r)) {
+    r->x0 = r->y0 = 0;
+    r->x1 = r->y1 = 1;
+  }
+}
+
+
+
+/* #pragma mark Scan */
+
+/* Compare n pixels of a row. memcmp skips the rows left as they are (it is
+ * vectorised by the C library), the ends of a changed span are then found
+ * pixel by pixel.
+ * 'bad' gets the pixels which should become transparent.
+ */
+static void GIF_DiffSpan(const Uint32 * a, const Uint32 * b, Uint32 x,
+                         Uint32 n, Uint32 y, GIF_DiffRect * chg,
+                         GIF_DiffRect * bad) {
+  Uint32 i, j, k;
+  
+  if (n == 0 || memcmp(a + x, b + x, n * sizeof *a) == 0)
+    return;
+  
+  for (i = x; a[i] == b[i]; i++)
+    ;
+  for (j = x + n - 1; a[j] == b[j]; j--)
+    ;
+  GIF_RectAdd(chg, i, j + 1, y);
+  
+  for (k = i; k <= j; k++)
+    if (b[k] == 0 && a[k] != 0)
+      GIF_RectAdd(bad, k, k + 1, y);
+}
+
+/* Same with a transparent canvas */
+static void GIF_DiffSpanClear(const Uint32 * b, Uint32 x, Uint32 n, Uint32 y,
+                              GIF_DiffRect * chg) {
+  Uint32 i, j;
+  
+  for (i = x; i < x + n && b[i] == 0; i++)
+    ;
+  if (i == x + n)
+    return;
+  for (j = x + n - 1; b[j] == 0; j--)
+    ;
+  GIF_RectAdd(chg, i, j + 1, y);
+}
+
+/* Rectangle of the pixels of 'cur' that differ from 'canvas', 'canvas'
+ * being transparent in 'clr' (the disposal of the pending frame).
+ */
+static void GIF_DiffScan(GIF_Optimizer * opt, const Uint32 * canvas,
+                         const GIF_DiffRect * clr, GIF_DiffRect * chg,
+                         GIF_DiffRect * bad) {
+  const Uint32 * a;
+  const Uint32 * b;
+  Uint32 y;
+  
+  GIF_RectClear(chg);
+  GIF_RectClear(bad);
+  
+  for (y = 0; y < opt->h; y++) {
+    a = canvas + y * opt->w;
+    b = opt->cur + y * opt->w;
+    
+    if (clr == NULL || GIF_RectEmpty(clr) || y < clr->y0 || y >= clr->y1) {
+      GIF_DiffSpan(a, b, 0, opt->w, y, chg, bad);
+      continue;
+    }
+    
+    GIF_DiffSpan(a, b, 0, clr->x0, y, chg, bad);
+    GIF_DiffSpanClear(b, clr->x0, clr->x1 - clr->x0, y, chg);
+    GIF_DiffSpan(a, b, clr->x1, opt->w - clr->x1, y, chg, bad);
+  }
+}
+
+
+
+/* #pragma mark Optimizer */
+
+GIF_Optimizer * GIF_OptimizerCreate(Uint16 w, Uint16 h) {
+  GIF_Optimizer * opt;
+  Uint32 n = (Uint32)w * h;
+  
+  opt = calloc(1, sizeof *opt);
+  if (opt == NULL)
+    return NULL;
+  
+  opt->w = w;
+  opt->h = h;
+  opt->base = calloc(n, sizeof *opt->base);
+  opt->prev = malloc(n * sizeof *opt->prev);
+  opt->cur = malloc(n * sizeof *opt->cur);
+  opt->out = malloc(n * 4);
+  
+  if (n == 0 || opt->base == NULL || opt->prev == NULL ||
+      opt->cur == NULL || opt->out == NULL) {
+    fprintf(stderr, "GIF_OptimizerCreate : Out of memory.\n");
+    GIF_OptimizerFree(opt);
+    return NULL;
+  }
+  
+  return opt;
+}
+
+void GIF_OptimizerFree(GIF_Optimizer * opt) {
+  if (opt == NULL)
+    return;
+  
+  free(opt->base);
+  free(opt->prev);
+  free(opt->cur);
+  free(opt->out);
+  free(opt);
+}
+
+/* Pixels of the pending frame : those the canvas already has are
+ * transparent.
+ */
+static void GIF_OptimizerEmit(GIF_Optimizer * opt, Uint8 dispMeth,
+                              GIF_DiffFrame * out) {
+  GIF_DiffRect * r = &opt->rect;
+  Uint32 * p = (Uint32 *)opt->out;
+  Uint32 x, y, i;
+  
+  for (y = r->y0; y < r->y1; y++)
+    for (x = r->x0; x < r->x1; x++) {
+      i = y * opt->w + x;
+      *p++ = opt->prev[i] == opt->base[i] ? 0 : opt->prev[i];
+    }
+  
+  out->x = r->x0;
+  out->y = r->y0;
+  out->w = r->x1 - r->x0;
+  out->h = r->y1 - r->y0;
+  out->dispMeth = dispMeth;
+  out->rgba = opt->out;
+}
+
+int GIF_OptimizerPush(GIF_Optimizer * opt, const Uint8 * rgba, Uint32 pitch,
+                      GIF_DiffFrame * out) {
+  GIF_DiffRect chg1, bad1, chg2, bad2, clr, next;
+  Uint32 cost1, cost2, x, y;
+  Uint32 * tmp;
+  Uint8 * q;
+  const Uint8 * p;
+  Uint8 dispMeth;
+  
+  for (y = 0; y < opt->h; y++) {
+    p = rgba + y * pitch;
+    q = (Uint8 *)(opt->cur + y * opt->w);
+    for (x = 0; x < opt->w; x++, p += 4, q += 4) {
+      if (p[3] < 128)
+        memset(q, 0, 4);
+      else {
+        memcpy(q, p, 3);
+        q[3] = 255;
+      }
+    }
+  }
+  
+  /* The decoder starts with a transparent canvas */
+  if (opt->nframes == 0) {
+    GIF_DiffScan(opt, opt->base, NULL, &opt->rect, &bad1);
+    GIF_RectMin(&opt->rect);
+    tmp = opt->prev, opt->prev = opt->cur, opt->cur = tmp;
+    opt->nframes++;
+    return 0;
+  }
+  
+  /* Leave the pending frame in place : only possible if no pixel has to
+   * become transparent.
+   */
+  GIF_DiffScan(opt, opt->prev, NULL, &chg1, &bad1);
+  cost1 = GIF_RectEmpty(&bad1) ? GIF_RectArea(&chg1) : 0xFFFFFFFF;
+  
+  /* Restore the background of the pending frame, grown if needed to clear
+   * the pixels becoming transparent.
+   */
+  clr = opt->rect;
+  GIF_DiffScan(opt, opt->prev, &clr, &chg2, &bad2);
+  if (!GIF_RectEmpty(&bad2)) {
+    GIF_RectUnion(&clr, &bad2);
+    GIF_DiffScan(opt, opt->prev, &clr, &chg2, &bad2);
+  }
+  cost2 = GIF_RectArea(&chg2) + GIF_RectArea(&clr) - GIF_RectArea(&opt->rect);
+  
+  if (cost1 <= cost2) {
+    dispMeth = 1;
+    next = chg1;
+  }
+  else {
+    dispMeth = 2;
+    opt->rect = clr;
+    next = chg2;
+  }
+  
+  GIF_OptimizerEmit(opt, dispMeth, out);
+  
+  /* The canvas the decoder has before the new frame */
+  tmp = opt->base, opt->base = opt->prev, opt->prev = opt->cur, opt->cur = tmp;
+  if (dispMeth == 2)
+    for (y = opt->rect.y0; y < opt->rect.y1; y++)
+      memset(opt->base + y * opt->w + opt->rect.x0, 0,
+             (opt->rect.x1 - opt->rect.x0) * sizeof *opt->base);
+  
+  opt->rect = next;
+  GIF_RectMin(&opt->rect);
+  opt->nframes++;
+  
+  return 1;
+}
+
+int GIF_OptimizerFlush(GIF_Optimizer * opt, GIF_DiffFrame * out) {
+  if (opt->nframes == 0)
+    return 0;
+  
+  GIF_OptimizerEmit(opt, 1, out);
+  
+  /* Ready for another animation */
+  memset(opt->base, 0, (Uint32)opt->w * opt->h * sizeof *opt->base);
+  opt->nframes = 0;
+  
+  return 1;
+}
@@ -0,0 +1,34 @@
+#ifndef GIF_OPTIMIZE_H
+#define GIF_OPTIMIZE_H
+
+/* Frame differencing for the encoder : each frame is reduced to the
+ * rectangle that changed on the canvas the decoder will have, the pixels
+ * left as they are become transparent.
+ * The disposal method of a frame depends on the next one, so a frame
+ * comes out of GIF_OptimizerPush when the next one goes in.
+ */
+
+typedef struct GIF_Optimizer_s GIF_Optimizer;
+
+typedef struct {
+  Uint16 x;               /* Rectangle to draw, on the logical screen */
+  Uint16 y;
+  Uint16 w;
+  Uint16 h;
+  Uint8 dispMeth;         /* 1 (leave in place) or 2 (restore background) */
+  const Uint8 * rgba;     /* w * h pixels, unchanged ones have alpha 0 */
+} GIF_DiffFrame;
+
+GIF_Optimizer * GIF_OptimizerCreate(Uint16 w, Uint16 h);
+void GIF_OptimizerFree(GIF_Optimizer * opt);
+
+/* 'rgba' is a whole frame, 4 bytes per pixel in R, G, B, A order.
+ * Return 1 if the previous frame was given in 'out', 0 for the first
+ * frame, -1 on error. 'out' is valid until the next call.
+ */
+int GIF_OptimizerPush(GIF_Optimizer * opt, const Uint8 * rgba, Uint32 pitch,
+                      GIF_DiffFrame * out);
+/* Give the last frame, return 0 if there is none */
+int GIF_OptimizerFlush(GIF_Optimizer * opt, GIF_DiffFrame * out);
+
+#endif
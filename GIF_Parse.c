@@ -0,0 +1,526 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <SDL.h>
+
+#include "GIF_Struct.h"
+#include "GIF_Parse.h"
+#include "GIF_LZW.h"
+#include "GIF_Hash.h"
+
+enum {
+  NDEFCOLTAB = 256,
+  NBITDEFCOLTAB = 7
+};
+
+GIF_THREAD_LOCAL Uint8 * pdata;
+GIF_THREAD_LOCAL Uint8 * pend;     /* End of the file, see GIF_PAD */
+
+GIF_Color defaultColTable[NDEFCOLTAB] = {
+  { 0x00, 0x00, 0x00, 0x00 },
+  { 0xFF, 0xFF, 0xFF, 0x00 }
+};
+
+
+
+/* Get nb bytes in s and return it byte ordered */
+unsigned GIF_GetInt(Uint8 * s, int nb) {
+  unsigned n = 0;
+  int i;
+  
+  for (i = 0; i < nb; i++) {
+    n <<= 8;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    n |= s[i];
+#elif SDL_BYTEORDER == SDL_LIL_ENDIAN
+    n |= s[nb - i - 1];
+#endif
+  }
+  
+  return n;
+}
+
+
+
+
+Sint8 GIF_GetColorTable(GIF_Color ** cols, Uint16 * ncol, unsigned n) {
+  unsigned sz;
+  unsigned i;
+  
+  /* 3 x 2^(Size of [Global/Local] Color Table + 1) */
+  sz = 1 << (n + 1);
+  *cols = malloc(sz * sizeof **cols);
+  if (*cols == NULL)
+    return -1;
+  *ncol = sz;
+  
+  for (i = 0; i < sz; i++) {
+    (*cols)[i].r = *pdata++;
+    (*cols)[i].g = *pdata++;
+    (*cols)[i].b = *pdata++;
+  }
+  
+  return 0;
+}
+
+
+/* Header - 6 bytes :
+ * -> 3 bytes : signature - "GIF"
+ * -> 3 bytes : version - 87A / 89A
+ */
+Uint8 GIF_GetHeader(void) {
+  Uint8 vers;
+  
+  if (strncmp((const char*)pdata, "GIF", 3))
+    return GIF_UKNOW;
+  
+  pdata += 3;
+  
+  if (strncmp((const char*)pdata, "87a", 3) == 0)
+    vers = GIF_87A;
+  else if (strncmp((const char*)pdata, "89a", 3) == 0)
+    vers = GIF_89A;
+  else
+    vers = GIF_UKNOW;
+  
+  pdata += 3;
+  
+  return vers;
+}
+
+/* Logical Screen Descriptor - 6 bytes :
+ * -> 2 bytes : Logical screen width
+ * -> 2 bytes : Logical screen height
+ * -> 1 byte  : - 1 bit  : global color table flag
+ *              - 3 bits : color resolution
+ *              - 1 bit  : sort flag
+ *              - 3 bits : size of global color table
+ * -> 1 byte  : background color index
+ * -> 1 byte  : pixel aspect ratio
+ */
+
+Sint8 GIF_GetLogScrDescriptor(GIF_Raw * gif) {
+  Uint8 gcolTable;
+  Uint8 szgcolTable;
+  
+  gif->w = GIF_GetInt(pdata, 2);
+  pdata += 2;
+  
+  gif->h = GIF_GetInt(pdata, 2);
+  pdata += 2;
+  
+  /* At least one canvas of 32-bit pixels */
+  if (gif->budget != 0 &&
+      (Uint64)gif->w * gif->h * sizeof(Uint32) > gif->budget) {
+    fprintf(stderr, "GIF_GetLogScrDescriptor : Over the memory budget.\n");
+    gif->over = 1;
+    return -1;
+  }
+  
+  gcolTable = (*pdata) >> 7;
+  szgcolTable = (*pdata) & 0x7;
+  pdata++;
+  
+  gif->bckColIndex = *pdata;
+  pdata++;
+  
+  /* Pixel aspect ratio, skipping... */
+  pdata++;
+  
+  if (gcolTable) {
+    if (GIF_GetColorTable(&gif->gcolTable, &gif->ngcol, szgcolTable) < 0)
+      return -1;
+  }
+  else {
+    gif->gcolTable = defaultColTable;
+    gif->ngcol = NDEFCOLTAB;
+  }
+  
+  return 0;
+}
+
+/* Image Descriptor - 9 bytes :
+ * -> 1 byte  : Image separator - fixed value 0x2C
+ * -> 2 bytes : Image left position
+ * -> 2 bytes : Image top position
+ * -> 2 bytes : Image width
+ * -> 2 bytes : Image height
+ * -> 1 byte  : - 1 bit  : local color table flag
+ *              - 1 bit  : interlace flag
+ *              - 1 bit  : sort flag
+ *              - 2 bits : reserved
+ *              - 3 bits : size of local color table
+ */
+
+Sint8 GIF_GetImgDescriptor(GIF_Raw * gif) {
+  GIF_Image * img = &gif->img[gif->i];
+  Uint8 lcolTable;
+  Uint8 szlcolTable;
+  
+  img->imgLftPos = GIF_GetInt(pdata, 2);
+  pdata += 2;
+  
+  img->imgTopPos = GIF_GetInt(pdata, 2);
+  pdata += 2;
+  
+  img->imgWidth = GIF_GetInt(pdata, 2);
+  pdata += 2;
+  
+  img->imgHeight = GIF_GetInt(pdata, 2);
+  pdata += 2;
+  
+  lcolTable = ((*pdata) >> 7) & 0x1;
+  img->interlace = ((*pdata) >> 6) & 0x1;
+  szlcolTable = (*pdata) & 0x7;
+  pdata++;
+  
+  if (lcolTable) {
+    if (GIF_GetColorTable(&img->lcolTable, &img->nlcol, szlcolTable) < 0)
+      return -1;
+  }
+  else {
+    img->lcolTable = gif->gcolTable;
+    img->nlcol = gif->ngcol;
+  }
+  
+  return 0;
+}
+
+
+
+/* Extensions */
+/* #pragma mark Extensions */
+
+/* Graphic Control Extension - 7 bytes :
+ * -> 1 byte  : Extension introducer - fixed value 0x21
+ * -> 1 byte  : Graphic control label - fixed value 0xF9
+ * -> 1 byte  : Block size - fixed value 4
+ * -> 1 byte  : - 3 bits : reserved
+ *              - 3 bits : disposal method
+ *              - 1 bit  : user input flag
+ *              - 1 bit  : transparent color flag
+ * -> 2 bytes : Delay time
+ * -> 1 byte  : Transparent color index
+ * -> 1 byte  : block terminator - fixed value 0x00
+ */
+
+Sint8 GIF_GetGraphCtrlExt(GIF_Raw * gif) {
+  if (*pdata++ != 4)
+    return -1;
+  
+  gif->img[gif->i].dispMeth = ((*pdata) >> 2) & 0x7;
+  gif->img[gif->i].userInput = ((*pdata) >> 1) & 0x1;
+  gif->img[gif->i].transpColor = (*pdata) & 0x1;
+  pdata++;
+  
+  gif->img[gif->i].delay = GIF_GetInt(pdata, 2);
+  pdata += 2;
+  
+  gif->img[gif->i].transpColorIdx = *pdata;
+  pdata++;
+  
+  /* Skip the block terminator */
+  pdata++;
+  
+  return 0;
+}
+
+/* Handlers of the other extensions, by label. They are registered before
+ * loading, the table is only read while parsing.
+ */
+typedef struct {
+  GIF_ExtFunc f;
+  void * data;
+} GIF_ExtHandler;
+
+static GIF_ExtHandler extHandlers[256];
+
+/* Set the handler of an extension label, NULL to skip it again */
+void GIF_SetExtHandler(Uint8 label, GIF_ExtFunc f, void * data) {
+  if (label == GIF_EXT_GRAPHCTRL)
+    return;
+  
+  extHandlers[label].f = f;
+  extHandlers[label].data = data;
+}
+
+int GIF_HasExtHandler(Uint8 label) {
+  return extHandlers[label].f != NULL;
+}
+
+void GIF_CallExtHandler(Uint8 label, const Uint8 * data, Uint32 size) {
+  GIF_Extension ext;
+  
+  ext.label = label;
+  ext.data = data;
+  ext.size = size;
+  extHandlers[label].f(extHandlers[label].data, &ext);
+}
+
+/* Bytes of the sub-block after 'pos' (NULL for the first one) and its
+ * length, NULL after the last one.
+ */
+const Uint8 * GIF_ExtSubBlock(const GIF_Extension * ext, const Uint8 * pos,
+                              Uint8 * len) {
+  const Uint8 * p;
+  
+  p = pos == NULL ? ext->data : pos + pos[-1];
+  if (p >= ext->data + ext->size)
+    return NULL;
+  
+  *len = *p;
+  return p + 1;
+}
+
+/* NETSCAPE2.0 (or ANIMEXTS1.0) Application Extension :
+ * -> Sub-block 1, 3 bytes : 1, number of loops (0 : forever)
+ * -> Sub-block 2, 5 bytes : 2, size of the buffer to read the file
+ * 'loops' and 'bufsz' are only set if their sub-block is there.
+ * Return 0, -1 if 'ext' isn't one.
+ */
+int GIF_GetLoopExt(const GIF_Extension * ext, Uint16 * loops, Uint32 * bufsz) {
+  const Uint8 * p;
+  Uint8 len;
+  
+  p = GIF_ExtSubBlock(ext, NULL, &len);
+  if (ext->label != GIF_EXT_APP || p == NULL || len != 11 ||
+      (memcmp(p, "NETSCAPE2.0", 11) != 0 && memcmp(p, "ANIMEXTS1.0", 11) != 0))
+    return -1;
+  
+  while ((p = GIF_ExtSubBlock(ext, p, &len)) != NULL) {
+    if (len >= 3 && p[0] == 1 && loops != NULL)
+      *loops = GIF_GetInt((Uint8 *)p + 1, 2);
+    else if (len >= 5 && p[0] == 2 && bufsz != NULL)
+      *bufsz = GIF_GetInt((Uint8 *)p + 1, 4);
+  }
+  
+  return 0;
+}
+
+/* Any other extension - 2 bytes + N bytes :
+ * -> 1 byte  : Extension introducer - fixed value 0x21
+ * -> 1 byte  : Label (0x01 plain text, 0xFE comment, 0xFF application...)
+ *
+ * -> Data sub-blocks (an application extension begins with 11 bytes :
+ *    identifier and authentication code)
+ *
+ * -> 1 byte  : block terminator - fixed value 0x00
+ *
+ * It goes to its handler as it is in the file, skipped if there is none.
+ */
+
+Sint8 GIF_GetOtherExt(Uint8 label) {
+  Uint8 * start = pdata;
+  
+  if (label == GIF_EXT_APP && *pdata != 11)
+    return -1;
+  
+  while (*pdata != 0)
+    pdata += *pdata + 1;
+  
+  if (pdata >= pend) {
+    fprintf(stderr, "GIF_GetOtherExt : Unexpected end of file.\n");
+    return -1;
+  }
+  
+  if (extHandlers[label].f != NULL)
+    GIF_CallExtHandler(label, start, pdata - start);
+  
+  /* Skip the block terminator */
+  pdata++;
+  
+  return 0;
+}
+
+/* An extension begin with a 0x21 byte */
+
+Sint8 GIF_GetExtension(GIF_Raw * gif) {
+  Uint8 label = *pdata++;
+  
+  if (label == GIF_EXT_GRAPHCTRL)
+    return GIF_GetGraphCtrlExt(gif);
+  
+  return GIF_GetOtherExt(label);
+}
+
+/* #pragma mark Images */
+
+void GIF_InitImage(GIF_Raw * gif, GIF_Image * img) {
+  img->delay = 0;
+  img->dispMeth = 0;
+  img->imgHeight = gif->h;
+  img->imgWidth = gif->w;
+  img->imgLftPos = 0;
+  img->imgTopPos = 0;
+  img->interlace = 0;
+  img->transpColor = 0;
+  img->userInput = 0;
+  img->lcolTable = gif->gcolTable;
+  img->nlcol = gif->ngcol;
+  img->shared = 0;
+  img->data = NULL;
+}
+
+/* Free the index plane and the local color table of an image */
+
+void GIF_FreeImage(GIF_Raw * gif, GIF_Image * img) {
+  if (!img->shared)
+    free(img->data);
+  if (img->lcolTable != gif->gcolTable)
+    free(img->lcolTable);
+  
+  img->data = NULL;
+  img->lcolTable = gif->gcolTable;
+}
+
+/* Decode the image data, or reuse the indices of a previous image which
+ * had the same compressed data
+ */
+
+Sint8 GIF_GetImageData(GIF_Raw * gif) {
+  GIF_Image * img = &gif->img[gif->i];
+  GIF_Image * prv;
+  Uint8 * p;
+  Uint64 n;
+  Uint32 i;
+  
+  /* Minimum code size, data sub-blocks and block terminator */
+  p = pdata + 1;
+  while (*p != 0)
+    p += *p + 1;
+  p++;
+  
+  /* The LZW decoder reads the same chain, it stays in the file */
+  if (p > pend) {
+    fprintf(stderr, "GIF_GetImageData : Unexpected end of file.\n");
+    return -1;
+  }
+  
+  img->lzw = pdata;
+  img->lzwSz = p - pdata;
+  img->hash = GIF_Hash(GIF_HASH_SEED, &img->imgWidth, sizeof img->imgWidth);
+  img->hash = GIF_Hash(img->hash, &img->imgHeight, sizeof img->imgHeight);
+  img->hash = GIF_Hash(img->hash, img->lzw, img->lzwSz);
+  
+  for (i = 0; i < gif->i; i++) {
+    prv = &gif->img[i];
+    
+    if (prv->hash == img->hash && prv->lzwSz == img->lzwSz &&
+        prv->imgWidth == img->imgWidth && prv->imgHeight == img->imgHeight &&
+        memcmp(prv->lzw, img->lzw, img->lzwSz) == 0) {
+      img->data = prv->data;
+      img->shared = 1;
+      pdata = p;
+      return 0;
+    }
+  }
+  
+  n = (Uint64)img->imgWidth * img->imgHeight * sizeof *img->data;
+  if (gif->budget != 0 && gif->mem + n > gif->budget) {
+    fprintf(stderr, "GIF_GetImageData : Over the memory budget.\n");
+    gif->over = 1;
+    return -1;
+  }
+  gif->mem += n;
+  
+  return GIF_LZW_GetData(img);
+}
+
+/* Get 1 image */
+
+Sint8 GIF_GetImage(GIF_Raw * gif) {
+  GIF_Image * img;
+  
+  img = realloc(gif->img, (gif->i + 1) * sizeof *gif->img);
+  if (img == NULL)
+    return -1;
+  gif->img = img;
+  
+  img = &gif->img[gif->i];
+  
+  GIF_InitImage(gif, img);
+  
+  while (1) {
+    
+    /* A missing trailer ends the file like one */
+    if (pdata == pend)
+      return 1;
+    if (pdata > pend) {
+      fprintf(stderr, "GIF_GetImage: Unexpected end of file.\n");
+      return -1;
+    }
+    
+    switch (*pdata++) {
+        /* Extensions */
+      case 0x21:
+        if (GIF_GetExtension(gif) < 0)
+          return -1;
+        break;
+      
+        /* Image */
+      case 0x2C:
+        /* The image isn't counted, GIF_FreeRaw won't see it */
+        if (GIF_GetImgDescriptor(gif) < 0 || GIF_GetImageData(gif) < 0) {
+          GIF_FreeImage(gif, img);
+          return -1;
+        }
+      
+        return 0;
+        break;
+      
+        /* Trailer */
+      case 0x3B:
+        return 1;
+        break;
+      
+      default:
+        fprintf(stderr, "GIF_GetImage: Unknown code.\n");
+        return -1;
+        break;
+    }
+  }
+  
+  
+  return 0;
+}
+
+/* Free the raw images once they have been rendered */
+
+void GIF_FreeRaw(GIF_Raw * gif) {
+  Uint32 i;
+  
+  for (i = 0; i < gif->i; i++)
+    GIF_FreeImage(gif, &gif->img[i]);
+  
+  if (gif->gcolTable != defaultColTable)
+    free(gif->gcolTable);
+  
+  free(gif->img);
+  free(gif);
+}
+
+/* Get all the images */
+
+Sint8 GIF_GetImages(GIF_Raw * gif) {
+  Sint8 tmp;
+  
+  gif->img = NULL;
+  gif->i = 0;
+  
+  while (1) {
+    tmp = GIF_GetImage(gif);
+    
+    if (tmp < 0) {
+      fprintf(stderr, "GIF_GetImages: Frame error.\n");
+      return -1;
+    }
+    else if (tmp == 1)
+      break;
+    
+    gif->i++;
+  }
+  
+  return 0;
+}
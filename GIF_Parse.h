@@ -0,0 +1,30 @@
+#ifndef GIF_PARSE_H
+#define GIF_PARSE_H
+
+#include "GIF_Struct.h"
+
+extern GIF_Color defaultColTable[];
+
+/* The parse functions read at 'pdata' and move it past what they read */
+
+unsigned GIF_GetInt(Uint8 * s, int nb);
+Sint8 GIF_GetColorTable(GIF_Color ** cols, Uint16 * ncol, unsigned n);
+
+Uint8 GIF_GetHeader(void);
+Sint8 GIF_GetLogScrDescriptor(GIF_Raw * gif);
+Sint8 GIF_GetImgDescriptor(GIF_Raw * gif);
+
+Sint8 GIF_GetGraphCtrlExt(GIF_Raw * gif);
+Sint8 GIF_GetOtherExt(Uint8 label);
+int GIF_HasExtHandler(Uint8 label);
+void GIF_CallExtHandler(Uint8 label, const Uint8 * data, Uint32 size);
+Sint8 GIF_GetExtension(GIF_Raw * gif);
+
+void GIF_InitImage(GIF_Raw * gif, GIF_Image * img);
+Sint8 GIF_GetImageData(GIF_Raw * gif);
+Sint8 GIF_GetImage(GIF_Raw * gif);
+Sint8 GIF_GetImages(GIF_Raw * gif);
+void GIF_FreeImage(GIF_Raw * gif, GIF_Image * img);
+void GIF_FreeRaw(GIF_Raw * gif);
+
+#endif
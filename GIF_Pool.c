@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Struct.h"
+#include "GIF_Pool.h"
+
+
+typedef struct {
+  GIF_TaskFunc f;
+  void * data;
+} GIF_Task;
+
+/* Queue of a worker : the owner takes the newest task (head), thieves
+ * take the oldest one (tail).
+ */
+typedef struct {
+  GIF_Task * tasks;
+  Uint32 cap;         /* Power of two */
+  Uint32 head;
+  Uint32 tail;
+  SDL_mutex * lock;
+} GIF_Deque;
+
+typedef struct {
+  GIF_Pool * pool;
+  int id;
+  SDL_Thread * thread;
+} GIF_Worker;
+
+struct GIF_Pool_s {
+  GIF_Deque * deques;
+  GIF_Worker * workers;
+  int n;
+  
+  SDL_mutex * lock;     /* Protects the fields below */
+  SDL_cond * work;      /* Signaled when a task is submitted */
+  SDL_cond * idle;      /* Signaled when 'pending' gets to 0 */
+  Uint32 queued;        /* Tasks in the queues */
+  Uint32 pending;       /* Tasks queued or running */
+  Uint32 next;          /* Queue of the next task submitted */
+  Uint8 quit;
+};
+
+
+
+/* #pragma mark Queues */
+
+static int GIF_DequePush(GIF_Deque * dq, GIF_Task * t) {
+  GIF_Task * tasks;
+  Uint32 i, n;
+  
+  SDL_LockMutex(dq->lock);
+  
+  n = dq->head - dq->tail;
+  if (n == dq->cap) {
+    tasks = malloc(2 * dq->cap * sizeof *tasks);
+    if (tasks == NULL) {
+      SDL_UnlockMutex(dq->lock);
+      return -1;
+    }
+    for (i = 0; i < n; i++)
+      tasks[i] = dq->tasks[(dq->tail + i) & (dq->cap - 1)];
+    free(dq->tasks);
+    dq->tasks = tasks;
+    dq->cap *= 2;
+    dq->tail = 0;
+    dq->head = n;
+  }
+  
+  dq->tasks[dq->head++ & (dq->cap - 1)] = *t;
+  
+  SDL_UnlockMutex(dq->lock);
+  
+  return 0;
+}
+
+/* Newest task for the owner, oldest one for a thief */
+static int GIF_DequePop(GIF_Deque * dq, GIF_Task * t, int steal) {
+  int ret = -1;
+  
+  SDL_LockMutex(dq->lock);
+  
+  if (dq->head != dq->tail) {
+    if (steal)
+      *t = dq->tasks[dq->tail++ & (dq->cap - 1)];
+    else
+      *t = dq->tasks[--dq->head & (dq->cap - 1)];
+    ret = 0;
+  }
+  
+  SDL_UnlockMutex(dq->lock);
+  
+  return ret;
+}
+
+
+
+/* #pragma mark Workers */
+
+/* Own queue first, then the others, starting with the next worker */
+static int GIF_PoolTake(GIF_Pool * pool, int id, GIF_Task * t) {
+  int i;
+  
+  if (GIF_DequePop(&pool->deques[id], t, 0) == 0)
+    return 0;
+  
+  for (i = 1; i < pool->n; i++)
+    if (GIF_DequePop(&pool->deques[(id + i) % pool->n], t, 1) == 0)
+      return 0;
+  
+  return -1;
+}
+
+static int GIF_PoolThread(void * data) {
+  GIF_Worker * w = data;
+  GIF_Pool * pool = w->pool;
+  GIF_Task t;
+  
+  while (1) {
+    SDL_LockMutex(pool->lock);
+    while (pool->queued == 0 && !pool->quit)
+      SDL_CondWait(pool->work, pool->lock);
+    if (pool->queued == 0 && pool->quit) {
+      SDL_UnlockMutex(pool->lock);
+      break;
+    }
+    SDL_UnlockMutex(pool->lock);
+    
+    /* Another worker may have been faster */
+    if (GIF_PoolTake(pool, w->id, &t) < 0)
+      continue;
+    
+    SDL_LockMutex(pool->lock);
+    pool->queued--;
+    SDL_UnlockMutex(pool->lock);
+    
+    t.f(t.data, w->id);
+    
+    SDL_LockMutex(pool->lock);
+    if (--pool->pending == 0)
+      SDL_CondBroadcast(pool->idle);
+    SDL_UnlockMutex(pool->lock);
+  }
+  
+  return 0;
+}
+
+GIF_Pool * GIF_PoolCreate(int nthreads) {
+  GIF_Pool * pool;
+  int i;
+  
+  if (nthreads < 1)
+    nthreads = 1;
+  
+  pool = calloc(1, sizeof *pool);
+  if (pool == NULL)
+    return NULL;
+  
+  pool->n = nthreads;
+  pool->deques = calloc(nthreads, sizeof *pool->deques);
+  pool->workers = calloc(nthreads, sizeof *pool->workers);
+  pool->lock = SDL_CreateMutex();
+  pool->work = SDL_CreateCond();
+  pool->idle = SDL_CreateCond();
+  if (pool->deques == NULL || pool->workers == NULL || pool->lock == NULL ||
+      pool->work == NULL || pool->idle == NULL) {
+    GIF_PoolFree(pool);
+    return NULL;
+  }
+  
+  for (i = 0; i < nthreads; i++) {
+    pool->deques[i].cap = 16;
+    pool->deques[i].tasks = malloc(16 * sizeof *pool->deques[i].tasks);
+    pool->deques[i].lock = SDL_CreateMutex();
+    if (pool->deques[i].tasks == NULL || pool->deques[i].lock == NULL) {
+      GIF_PoolFree(pool);
+      return NULL;
+    }
+  }
+  
+  for (i = 0; i < nthreads; i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].id = i;
+    pool->workers[i].thread = GIF_CreateThread(GIF_PoolThread, "GIF_Pool",
+                                               &pool->workers[i]);
+    if (pool->workers[i].thread == NULL) {
+      fprintf(stderr, "GIF_PoolCreate : SDL_CreateThread : %s\n",
+              SDL_GetError());
+      GIF_PoolFree(pool);
+      return NULL;
+    }
+  }
+  
+  return pool;
+}
+
+int GIF_PoolSize(GIF_Pool * pool) {
+  return pool->n;
+}
+
+/* Tasks are spread over the queues in turn */
+int GIF_PoolSubmit(GIF_Pool * pool, GIF_TaskFunc f, void * data) {
+  GIF_Task t;
+  int ret;
+  
+  t.f = f;
+  t.data = data;
+  
+  SDL_LockMutex(pool->lock);
+  
+  ret = GIF_DequePush(&pool->deques[pool->next++ % pool->n], &t);
+  if (ret == 0) {
+    pool->queued++;
+    pool->pending++;
+    SDL_CondSignal(pool->work);
+  }
+  
+  SDL_UnlockMutex(pool->lock);
+  
+  return ret;
+}
+
+/* Wait for every task submitted to be done */
+void GIF_PoolWait(GIF_Pool * pool) {
+  SDL_LockMutex(pool->lock);
+  while (pool->pending != 0)
+    SDL_CondWait(pool->idle, pool->lock);
+  SDL_UnlockMutex(pool->lock);
+}
+
+/* The tasks left are run before the workers stop */
+void GIF_PoolFree(GIF_Pool * pool) {
+  int i;
+  
+  if (pool == NULL)
+    return;
+  
+  if (pool->lock != NULL) {
+    SDL_LockMutex(pool->lock);
+    pool->quit = 1;
+    SDL_CondBroadcast(pool->work);
+    SDL_UnlockMutex(pool->lock);
+  }
+  
+  if (pool->workers != NULL)
+    for (i = 0; i < pool->n; i++)
+      if (pool->workers[i].thread != NULL)
+        SDL_WaitThread(pool->workers[i].thread, NULL);
+  
+  if (pool->deques != NULL)
+    for (i = 0; i < pool->n; i++) {
+      free(pool->deques[i].tasks);
+      if (pool->deques[i].lock != NULL)
+        SDL_DestroyMutex(pool->deques[i].lock);
+    }
+  
+  if (pool->idle != NULL)
+    SDL_DestroyCond(pool->idle);
+  if (pool->work != NULL)
+    SDL_DestroyCond(pool->work);
+  if (pool->lock != NULL)
+    SDL_DestroyMutex(pool->lock);
+  free(pool->deques);
+  free(pool->workers);
+  free(pool);
+}
@@ -0,0 +1,19 @@
+#ifndef GIF_POOL_H
+#define GIF_POOL_H
+
+/* Work-stealing thread pool : each worker has its own queue and takes the
+ * oldest tasks of the others when it is empty.
+ */
+
+typedef struct GIF_Pool_s GIF_Pool;
+
+/* 'worker' is in [0, GIF_PoolSize[, for per-worker scratch data */
+typedef void (*GIF_TaskFunc)(void * data, int worker);
+
+GIF_Pool * GIF_PoolCreate(int nthreads);
+int GIF_PoolSize(GIF_Pool * pool);
+int GIF_PoolSubmit(GIF_Pool * pool, GIF_TaskFunc f, void * data);
+void GIF_PoolWait(GIF_Pool * pool);
+void GIF_PoolFree(GIF_Pool * pool);
+
+#endif
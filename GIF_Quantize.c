@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Quantize.h"
+
+
+enum {
+  GIF_QUANT_BITS = 5,                       /* Bits kept per channel */
+  GIF_QUANT_SIDE = 1 << GIF_QUANT_BITS,
+  GIF_QUANT_NBINS = 1 << (3 * GIF_QUANT_BITS),
+  GIF_QUANT_UNSET = 0xFFFF                  /* Cube entry not computed yet */
+};
+
+/* Bin of a color : 5 bits of red, green and blue */
+#define GIF_QUANT_BIN(r, g, b)                                          \
+  (((r) >> 3) << (2 * GIF_QUANT_BITS) | ((g) >> 3) << GIF_QUANT_BITS | ((b) >> 3))
+
+/* Box of the median cut, bounds are bins and inclusive */
+typedef struct {
+  Uint8 lo[3];
+  Uint8 hi[3];
+  Uint32 n;           /* Number of pixels */
+} GIF_QuantBox;
+
+struct GIF_Quantizer_s {
+  Uint32 count[GIF_QUANT_NBINS];
+  Uint64 sum[GIF_QUANT_NBINS][3];   /* To give each box its mean color */
+  Uint32 ntransp;                   /* Transparent pixels seen */
+  
+  SDL_Color pal[256];
+  Uint16 ncol;                      /* Opaque colors of 'pal' */
+  Sint16 transp;                    /* Index of the transparent color */
+  
+  /* Nearest color of each bin, filled when first needed */
+  Uint16 cube[GIF_QUANT_NBINS];
+};
+
+/* 4x4 Bayer matrix */
+static const Uint8 bayer[4][4] = {
+  {  0,  8,  2, 10 },
+  { 12,  4, 14,  6 },
+  {  3, 11,  1,  9 },
+  { 15,  7, 13,  5 }
+};
+
+
+
+GIF_Quantizer * GIF_QuantizerCreate(void) {
+  GIF_Quantizer * q;
+  
+  q = malloc(sizeof *q);
+  if (q == NULL) {
+    perror("GIF_QuantizerCreate : malloc");
+    return NULL;
+  }
+  
+  GIF_QuantizerReset(q);
+  q->ncol = 0;
+  q->transp = -1;
+  memset(q->cube, 0xFF, sizeof q->cube);
+  
+  return q;
+}
+
+void GIF_QuantizerFree(GIF_Quantizer * q) {
+  free(q);
+}
+
+void GIF_QuantizerReset(GIF_Quantizer * q) {
+  memset(q->count, 0, sizeof q->count);
+  memset(q->sum, 0, sizeof q->sum);
+  q->ntransp = 0;
+}
+
+/* Rows are read 4 pixels at a time so that the bin computation of each
+ * group has no dependency and can be vectorised by the compiler.
+ */
+void GIF_QuantizerAdd(GIF_Quantizer * q, const Uint8 * rgba,
+                      Uint16 w, Uint16 h, Uint32 pitch) {
+  const Uint8 * p;
+  Uint32 k[4];
+  Uint32 x, y, i;
+  
+  for (y = 0; y < h; y++) {
+    p = rgba + y * pitch;
+    
+    for (x = 0; x + 4 <= w; x += 4, p += 16) {
+      for (i = 0; i < 4; i++)
+        k[i] = GIF_QUANT_BIN(p[4 * i], p[4 * i + 1], p[4 * i + 2]);
+      
+      for (i = 0; i < 4; i++) {
+        if (p[4 * i + 3] < 128) {
+          q->ntransp++;
+          continue;
+        }
+        q->count[k[i]]++;
+        q->sum[k[i]][0] += p[4 * i];
+        q->sum[k[i]][1] += p[4 * i + 1];
+        q->sum[k[i]][2] += p[4 * i + 2];
+      }
+    }
+    
+    for (; x < w; x++, p += 4) {
+      if (p[3] < 128) {
+        q->ntransp++;
+        continue;
+      }
+      k[0] = GIF_QUANT_BIN(p[0], p[1], p[2]);
+      q->count[k[0]]++;
+      q->sum[k[0]][0] += p[0];
+      q->sum[k[0]][1] += p[1];
+      q->sum[k[0]][2] += p[2];
+    }
+  }
+}
+
+
+
+/* #pragma mark Median cut */
+
+/* Shrink the box to the bins used, and count its pixels */
+static void GIF_QuantShrink(GIF_Quantizer * q, GIF_QuantBox * box) {
+  Uint8 lo[3] = { GIF_QUANT_SIDE, GIF_QUANT_SIDE, GIF_QUANT_SIDE };
+  Uint8 hi[3] = { 0, 0, 0 };
+  Uint32 r, g, b, c;
+  
+  box->n = 0;
+  
+  for (r = box->lo[0]; r <= box->hi[0]; r++)
+    for (g = box->lo[1]; g <= box->hi[1]; g++)
+      for (b = box->lo[2]; b <= box->hi[2]; b++) {
+        c = q->count[r << (2 * GIF_QUANT_BITS) | g << GIF_QUANT_BITS | b];
+        if (c == 0)
+          continue;
+        box->n += c;
+        if (r < lo[0]) lo[0] = r;
+        if (r > hi[0]) hi[0] = r;
+        if (g < lo[1]) lo[1] = g;
+        if (g > hi[1]) hi[1] = g;
+        if (b < lo[2]) lo[2] = b;
+        if (b > hi[2]) hi[2] = b;
+      }
+  
+  if (box->n != 0) {
+    memcpy(box->lo, lo, 3);
+    memcpy(box->hi, hi, 3);
+  }
+}
+
+/* Cut the box in two halves of pixels along its longest side.
+ * Return -1 if it only holds one bin.
+ */
+static int GIF_QuantSplit(GIF_Quantizer * q, GIF_QuantBox * box,
+                          GIF_QuantBox * nbox) {
+  Uint32 slices[GIF_QUANT_SIDE] = { 0 };
+  Uint32 i, axis = 0, cut, acc;
+  Uint32 v[3];
+  
+  for (i = 1; i < 3; i++)
+    if (box->hi[i] - box->lo[i] > box->hi[axis] - box->lo[axis])
+      axis = i;
+  
+  if (box->hi[axis] == box->lo[axis])
+    return -1;
+  
+  for (v[0] = box->lo[0]; v[0] <= box->hi[0]; v[0]++)
+    for (v[1] = box->lo[1]; v[1] <= box->hi[1]; v[1]++)
+      for (v[2] = box->lo[2]; v[2] <= box->hi[2]; v[2]++)
+        slices[v[axis]] += q->count[v[0] << (2 * GIF_QUANT_BITS) |
+                                    v[1] << GIF_QUANT_BITS | v[2]];
+  
+  acc = 0;
+  for (cut = box->lo[axis]; cut < box->hi[axis]; cut++) {
+    acc += slices[cut];
+    if (acc >= box->n / 2)
+      break;
+  }
+  if (cut == box->hi[axis])
+    cut--;
+  
+  *nbox = *box;
+  box->hi[axis] = cut;
+  nbox->lo[axis] = cut + 1;
+  
+  GIF_QuantShrink(q, box);
+  GIF_QuantShrink(q, nbox);
+  
+  return 0;
+}
+
+/* Build a palette of 'ncol' colors at most from the histogram.
+ * One entry is kept for transparency if transparent pixels were added,
+ * its index is given in 'transp', -1 otherwise.
+ */
+int GIF_QuantizerPalette(GIF_Quantizer * q, Uint16 ncol,
+                         SDL_Color * pal, Uint16 * npal, Sint16 * transp) {
+  GIF_QuantBox boxes[256];
+  Uint32 nboxes, i, best, r, g, b, k;
+  Uint64 score, bestScore, sum[3], n;
+  
+  if (ncol < 1 || ncol > 256 || (q->ntransp != 0 && ncol < 2)) {
+    fprintf(stderr, "GIF_QuantizerPalette : Bad number of colors.\n");
+    return -1;
+  }
+  
+  if (q->ntransp != 0)
+    ncol--;
+  
+  boxes[0].lo[0] = boxes[0].lo[1] = boxes[0].lo[2] = 0;
+  boxes[0].hi[0] = boxes[0].hi[1] = boxes[0].hi[2] = GIF_QUANT_SIDE - 1;
+  GIF_QuantShrink(q, &boxes[0]);
+  nboxes = boxes[0].n != 0;
+  
+  /* Split the box with the most pixels times the longest side */
+  while (nboxes < ncol) {
+    best = nboxes;
+    bestScore = 0;
+    for (i = 0; i < nboxes; i++) {
+      k = boxes[i].hi[0] - boxes[i].lo[0];
+      if ((Uint32)(boxes[i].hi[1] - boxes[i].lo[1]) > k)
+        k = boxes[i].hi[1] - boxes[i].lo[1];
+      if ((Uint32)(boxes[i].hi[2] - boxes[i].lo[2]) > k)
+        k = boxes[i].hi[2] - boxes[i].lo[2];
+      score = (Uint64)boxes[i].n * k;
+      if (score > bestScore) {
+        bestScore = score;
+        best = i;
+      }
+    }
+    
+    if (best == nboxes || GIF_QuantSplit(q, &boxes[best], &boxes[nboxes]) < 0)
+      break;
+    nboxes++;
+  }
+  
+  /* Mean color of each box */
+  memset(q->pal, 0, sizeof q->pal);
+  for (i = 0; i < nboxes; i++) {
+    sum[0] = sum[1] = sum[2] = 0;
+    n = 0;
+    for (r = boxes[i].lo[0]; r <= boxes[i].hi[0]; r++)
+      for (g = boxes[i].lo[1]; g <= boxes[i].hi[1]; g++)
+        for (b = boxes[i].lo[2]; b <= boxes[i].hi[2]; b++) {
+          k = r << (2 * GIF_QUANT_BITS) | g << GIF_QUANT_BITS | b;
+          n += q->count[k];
+          sum[0] += q->sum[k][0];
+          sum[1] += q->sum[k][1];
+          sum[2] += q->sum[k][2];
+        }
+    q->pal[i].r = (sum[0] + n / 2) / n;
+    q->pal[i].g = (sum[1] + n / 2) / n;
+    q->pal[i].b = (sum[2] + n / 2) / n;
+  }
+  
+  q->ncol = nboxes;
+  q->transp = -1;
+  if (q->ntransp != 0) {
+    q->transp = nboxes;
+    q->pal[nboxes].r = q->pal[nboxes].g = q->pal[nboxes].b = 0;
+    nboxes++;
+  }
+  
+  memcpy(pal, q->pal, nboxes * sizeof *pal);
+  *npal = nboxes;
+  *transp = q->transp;
+  
+  memset(q->cube, 0xFF, sizeof q->cube);
+  
+  return 0;
+}
+
+
+
+/* #pragma mark Mapping */
+
+/* Nearest opaque color of the center of bin k */
+static Uint16 GIF_QuantNearest(GIF_Quantizer * q, Uint32 k) {
+  Sint32 r = (k >> (2 * GIF_QUANT_BITS) << 3) | 4;
+  Sint32 g = ((k >> GIF_QUANT_BITS & (GIF_QUANT_SIDE - 1)) << 3) | 4;
+  Sint32 b = ((k & (GIF_QUANT_SIDE - 1)) << 3) | 4;
+  Sint32 dr, dg, db;
+  Uint32 d, best = 0xFFFFFFFF;
+  Uint16 i, idx = 0;
+  
+  for (i = 0; i < q->ncol; i++) {
+    dr = q->pal[i].r - r;
+    dg = q->pal[i].g - g;
+    db = q->pal[i].b - b;
+    d = dr * dr + dg * dg + db * db;
+    if (d < best) {
+      best = d;
+      idx = i;
+    }
+  }
+  
+  q->cube[k] = idx;
+  
+  return idx;
+}
+
+void GIF_QuantizerMap(GIF_Quantizer * q, const Uint8 * rgba,
+                      Uint16 w, Uint16 h, Uint32 pitch, Uint32 flags,
+                      Uint8 * idx) {
+  const Uint8 * p;
+  Sint32 r, g, b, d;
+  Uint32 x, y, k;
+  
+  for (y = 0; y < h; y++) {
+    p = rgba + y * pitch;
+    
+    for (x = 0; x < w; x++, p += 4, idx++) {
+      if (p[3] < 128 && q->transp >= 0) {
+        *idx = q->transp;
+        continue;
+      }
+      
+      if (flags & GIF_QUANT_DITHER) {
+        /* Move the color by up to one bin */
+        d = bayer[y & 3][x & 3] - 8;
+        r = p[0] + d;
+        g = p[1] + d;
+        b = p[2] + d;
+        r = r < 0 ? 0 : r > 255 ? 255 : r;
+        g = g < 0 ? 0 : g > 255 ? 255 : g;
+        b = b < 0 ? 0 : b > 255 ? 255 : b;
+        k = GIF_QUANT_BIN(r, g, b);
+      }
+      else
+        k = GIF_QUANT_BIN(p[0], p[1], p[2]);
+      
+      *idx = q->cube[k] != GIF_QUANT_UNSET ? q->cube[k] : GIF_QuantNearest(q, k);
+    }
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef GIF_QUANTIZE_H
+#define GIF_QUANTIZE_H
+
+/* Color quantizer : builds a palette of 256 colors at most from truecolor
+ * frames (median cut on a 15 bits histogram) and maps the pixels to it.
+ * Pixels are 4 bytes, in R, G, B, A order. Alpha below 128 is transparent.
+ */
+
+typedef struct GIF_Quantizer_s GIF_Quantizer;
+
+enum {
+  GIF_QUANT_DITHER = 0x01     /* Ordered (4x4 Bayer) dithering */
+};
+
+GIF_Quantizer * GIF_QuantizerCreate(void);
+void GIF_QuantizerFree(GIF_Quantizer * q);
+
+/* Histogram : add one or several frames, then build the palette */
+void GIF_QuantizerReset(GIF_Quantizer * q);
+void GIF_QuantizerAdd(GIF_Quantizer * q, const Uint8 * rgba,
+                      Uint16 w, Uint16 h, Uint32 pitch);
+int GIF_QuantizerPalette(GIF_Quantizer * q, Uint16 ncol,
+                         SDL_Color * pal, Uint16 * npal, Sint16 * transp);
+
+/* w * h indexes in 'idx', with the last palette built */
+void GIF_QuantizerMap(GIF_Quantizer * q, const Uint8 * rgba,
+                      Uint16 w, Uint16 h, Uint32 pitch, Uint32 flags,
+                      Uint8 * idx);
+
+#endif
@@ -0,0 +1,520 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <SDL.h>
+
+#include "GIF_Struct.h"
+#include "GIF_Render.h"
+#include "GIF_Hash.h"
+
+SDL_Surface * GIF_CreateRGBSurface(Uint16 w, Uint16 h) {
+  return SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 32, GIF_RMASK, GIF_GMASK,
+                              GIF_BMASK, 0);
+}
+
+/* Colors of 'cols' in the layout of the surfaces, missing ones are black */
+const Uint32 * GIF_PaletteMap(GIF_Palette * pal, const GIF_Color * cols,
+                              Uint16 n) {
+  Uint32 i;
+  
+  if (n > 256)
+    n = 256;
+  if (pal->cols == cols && pal->n == n)
+    return pal->lut;
+  
+  for (i = 0; i < n; i++)
+    pal->lut[i] = GIF_RGB(cols[i].r, cols[i].g, cols[i].b);
+  for (; i < 256; i++)
+    pal->lut[i] = 0;
+  pal->cols = cols;
+  pal->n = n;
+  
+  return pal->lut;
+}
+
+int GIF_BlitDispMethod1(SDL_Surface * dst, GIF_Image * img,
+                        const Uint32 * lut) {
+  Uint32 x0, x1, y, y1;
+  Uint16 * src;
+  Uint32 * p;
+  Uint32 l;
+  
+  x0 = img->imgLftPos;
+  x1 = x0 + img->imgWidth < (Uint32)dst->w ? x0 + img->imgWidth
+                                            : (Uint32)dst->w;
+  y1 = img->imgTopPos + img->imgHeight < (Uint32)dst->h ?
+       img->imgTopPos + img->imgHeight : dst->h;
+  
+  if (SDL_MUSTLOCK(dst))
+    SDL_LockSurface(dst);
+  
+  src = img->data;
+  for (y = img->imgTopPos; y < y1; y++, src += img->imgWidth) {
+    p = GIF_ROW(dst, y);
+    
+    if (!img->transpColor) {
+      for (l = x0; l < x1; l++)
+        p[l] = lut[src[l - x0] & 0xFF];
+    }
+    else {
+      for (l = x0; l < x1; l++)
+        if (src[l - x0] != img->transpColorIdx)
+          p[l] = lut[src[l - x0] & 0xFF];
+    }
+  }
+  
+  if (SDL_MUSTLOCK(dst))
+    SDL_UnlockSurface(dst);
+  
+  return 0;
+}
+
+int GIF_BlitDispMethod2(SDL_Surface * dst, SDL_Rect * r, Uint32 color) {
+  Uint32 x, y;
+  Uint32 k, l;
+  Uint32 * p;
+  
+  k = r->y + r->h;
+  l = r->x + r->w;
+  if (k > (Uint32)dst->h)
+    k = dst->h;
+  if (l > (Uint32)dst->w)
+    l = dst->w;
+  
+  if (SDL_MUSTLOCK(dst))
+    SDL_LockSurface(dst);
+  
+  for (y = r->y; y < k; y++) {
+    p = GIF_ROW(dst, y);
+    for (x = r->x; x < l; x++)
+      p[x] = color;
+  }
+  
+  if (SDL_MUSTLOCK(dst))
+    SDL_UnlockSurface(dst);
+  
+  return 0;
+}
+
+int GIF_BlitDispMethod3(SDL_Surface * src, SDL_Surface * dst, SDL_Rect * r) {
+  Uint32 y;
+  Uint32 k, l;
+  
+  k = r->y + r->h;
+  l = r->x + r->w;
+  if (k > (Uint32)dst->h)
+    k = dst->h;
+  if (l > (Uint32)dst->w)
+    l = dst->w;
+  if ((Uint32)r->x >= l)
+    return 0;
+  
+  if (SDL_MUSTLOCK(src))
+    SDL_LockSurface(src);
+  if (SDL_MUSTLOCK(dst))
+    SDL_LockSurface(dst);
+  
+  for (y = r->y; y < k; y++)
+    memcpy(GIF_ROW(dst, y) + r->x, GIF_ROW(src, y) + r->x,
+           (l - r->x) * sizeof(Uint32));
+  
+  if (SDL_MUSTLOCK(src))
+    SDL_UnlockSurface(src);
+  if (SDL_MUSTLOCK(dst))
+    SDL_UnlockSurface(dst);
+  
+  return 0;
+}
+
+/* As GIF_BlitDispMethod1, the rows of 'img' being stored in 4 passes */
+
+Sint8 GIF_RenderInterlace(GIF_Image * img, SDL_Surface * dst,
+                          const Uint32 * lut) {
+  Uint8 start[4] = { 0, 4, 2, 1 };
+  Uint8 off[4] = { 8, 8, 4, 2 };
+  Uint32 x0, x1, y, k, l;
+  Uint16 * src;
+  Uint32 * p;
+  
+  x0 = img->imgLftPos;
+  x1 = x0 + img->imgWidth < (Uint32)dst->w ? x0 + img->imgWidth
+                                            : (Uint32)dst->w;
+  
+  if (SDL_MUSTLOCK(dst))
+    SDL_LockSurface(dst);
+  
+  src = img->data;
+  for (k = 0; k < 4; k++) {
+    for (y = start[k]; y < img->imgHeight; y += off[k], src += img->imgWidth) {
+      if (img->imgTopPos + y >= (Uint32)dst->h)
+        continue;
+      p = GIF_ROW(dst, img->imgTopPos + y);
+      
+      if (!img->transpColor) {
+        for (l = x0; l < x1; l++)
+          p[l] = lut[src[l - x0] & 0xFF];
+      }
+      else {
+        for (l = x0; l < x1; l++)
+          if (src[l - x0] != img->transpColorIdx)
+            p[l] = lut[src[l - x0] & 0xFF];
+      }
+    }
+  }
+  
+  if (SDL_MUSTLOCK(dst))
+    SDL_UnlockSurface(dst);
+  
+  return 0;
+}
+
+/* Return 1 if the two images draw exactly the same pixels */
+
+int GIF_SameImage(GIF_Image * a, GIF_Image * b) {
+  Uint16 i;
+  
+  if (a->data != b->data ||
+      a->imgLftPos != b->imgLftPos || a->imgTopPos != b->imgTopPos ||
+      a->imgWidth != b->imgWidth || a->imgHeight != b->imgHeight ||
+      a->interlace != b->interlace || a->transpColor != b->transpColor ||
+      (a->transpColor && a->transpColorIdx != b->transpColorIdx))
+    return 0;
+  
+  if (a->lcolTable == b->lcolTable)
+    return 1;
+  
+  if (a->nlcol != b->nlcol)
+    return 0;
+  
+  for (i = 0; i < a->nlcol; i++) {
+    if (a->lcolTable[i].r != b->lcolTable[i].r ||
+        a->lcolTable[i].g != b->lcolTable[i].g ||
+        a->lcolTable[i].b != b->lcolTable[i].b)
+      return 0;
+  }
+  
+  return 1;
+}
+
+/* Hash the pixels of a surface */
+
+Uint32 GIF_HashSurface(SDL_Surface * sfc) {
+  Uint32 h = GIF_HASH_SEED;
+  Uint32 y;
+  
+  for (y = 0; y < (Uint32)sfc->h; y++)
+    h = GIF_Hash(h, (Uint8 *)sfc->pixels + y * sfc->pitch,
+                 sfc->w * sfc->format->BytesPerPixel);
+  
+  return h;
+}
+
+/* Return 1 if the two surfaces have the same pixels */
+
+int GIF_SameSurface(SDL_Surface * a, SDL_Surface * b) {
+  Uint32 y;
+  
+  for (y = 0; y < (Uint32)a->h; y++) {
+    if (memcmp((Uint8 *)a->pixels + y * a->pitch,
+               (Uint8 *)b->pixels + y * b->pitch,
+               a->w * a->format->BytesPerPixel) != 0)
+      return 0;
+  }
+  
+  return 1;
+}
+
+/* Return 1 if 'a' only changes the colors of 'b' : same indices at the same
+ * place, all of them drawn
+ */
+
+static int GIF_SamePixels(GIF_Image * a, GIF_Image * b) {
+  return a->data != NULL && a->data == b->data &&
+         a->imgLftPos == b->imgLftPos && a->imgTopPos == b->imgTopPos &&
+         a->imgWidth == b->imgWidth && a->imgHeight == b->imgHeight &&
+         !a->interlace && !a->transpColor;
+}
+
+/* Palette animation : the image covers the previous one with new colors.
+ * The canvas gets its rows shaded with 'lut', then they are copied to the
+ * frame and hashed while still in the cache, in one pass.
+ * Return the hash of the frame, as GIF_HashSurface.
+ */
+
+static Uint32 GIF_Reshade(SDL_Surface * canvas, SDL_Surface * dst,
+                          GIF_Image * img, const Uint32 * lut) {
+  Uint32 h = GIF_HASH_SEED;
+  Uint32 x0, x1, y0, y1, x, y;
+  Uint32 n = canvas->w * sizeof(Uint32);
+  Uint16 * src;
+  Uint32 * p;
+  
+  x0 = img->imgLftPos;
+  x1 = x0 + img->imgWidth < (Uint32)canvas->w ? x0 + img->imgWidth
+                                               : (Uint32)canvas->w;
+  y0 = img->imgTopPos;
+  y1 = y0 + img->imgHeight < (Uint32)canvas->h ? y0 + img->imgHeight
+                                                : (Uint32)canvas->h;
+  
+  if (SDL_MUSTLOCK(canvas))
+    SDL_LockSurface(canvas);
+  if (SDL_MUSTLOCK(dst))
+    SDL_LockSurface(dst);
+  
+  for (y = 0; y < (Uint32)canvas->h; y++) {
+    p = GIF_ROW(canvas, y);
+    if (y >= y0 && y < y1) {
+      src = img->data + (y - y0) * img->imgWidth;
+      for (x = x0; x < x1; x++)
+        p[x] = lut[src[x - x0] & 0xFF];
+    }
+    memcpy(GIF_ROW(dst, y), p, n);
+    h = GIF_Hash(h, p, n);
+  }
+  
+  if (SDL_MUSTLOCK(dst))
+    SDL_UnlockSurface(dst);
+  if (SDL_MUSTLOCK(canvas))
+    SDL_UnlockSurface(canvas);
+  
+  return h;
+}
+
+/* Return 1 if the image i is drawn again over the previous one, which
+ * leaves the canvas as it was
+ */
+
+static int GIF_Redrawn(GIF_Raw * raw, Uint32 i) {
+  return i > 0 && raw->img[i - 1].dispMeth != 2 &&
+         raw->img[i - 1].dispMeth != 3 &&
+         GIF_SameImage(&raw->img[i], &raw->img[i - 1]);
+}
+
+/* Surfaces needed by the frames, before the identical ones are merged */
+
+Uint32 GIF_CountSurfaces(GIF_Raw * raw) {
+  Uint32 n = 0;
+  Uint32 i;
+  
+  for (i = 0; i < raw->i; i++)
+    if (!GIF_Redrawn(raw, i))
+      n++;
+  
+  return n;
+}
+
+/* Make the frame i use the surface of the frame j */
+
+void GIF_ShareFrame(GIF_Surface * gif, Uint32 i, Uint32 j) {
+  SDL_FreeSurface(gif->images[i]);
+  gif->images[i] = gif->images[j];
+  gif->images[i]->refcount++;
+}
+
+/* Put all the raw images in an array of SDL_Surface */
+
+Sint8 GIF_RenderFrames(GIF_Raw * raw, GIF_Surface * gif) {
+  GIF_Palette gpal;
+  GIF_Palette lpal;
+  const Uint32 * lut;
+  SDL_Surface * sfc;
+  SDL_Surface * save;     /* Canvas restored by disposal method 3 */
+  SDL_Surface * next;     /* Surface of the next frame that isn't shared */
+  Uint32 * hash;
+  SDL_Rect r;
+  Uint32 col;
+  Uint32 i, j;
+  Uint32 alpha = GIF_TRANSPARENT;
+  
+  sfc = GIF_CreateRGBSurface(raw->w, raw->h);
+  if (sfc == NULL)
+    return -1;
+  
+  save = GIF_CreateRGBSurface(raw->w, raw->h);
+  if (save == NULL) {
+    SDL_FreeSurface(sfc);
+    return -1;
+  }
+  
+  gpal.cols = lpal.cols = NULL;
+  SDL_FillRect(sfc, NULL, alpha);
+  SDL_SetColorKey(sfc, GIF_COLORKEY, alpha);
+  
+  hash = malloc((gif->nimg + 1) * sizeof *hash);
+  if (hash == NULL) {
+    SDL_FreeSurface(sfc);
+    SDL_FreeSurface(save);
+    return -1;
+  }
+  
+  next = NULL;
+  for (i = 0; i < gif->nimg; i++) {
+    /* The canvas as it is before the image, restored after it */
+    if (raw->img[i].dispMeth == 3) {
+      r.x = r.y = 0;
+      r.w = raw->w;
+      r.h = raw->h;
+      GIF_BlitDispMethod3(sfc, save, &r);
+    }
+    
+    /* Drawing an image again over itself doesn't change the canvas */
+    if (GIF_Redrawn(raw, i)) {
+      GIF_ShareFrame(gif, i, i - 1);
+      hash[i] = hash[i - 1];
+    }
+    else {
+      /* Kept for the next frame when this one is shared */
+      if (next == NULL) {
+        next = GIF_CreateRGBSurface(raw->w, raw->h);
+        if (next == NULL) {
+          free(hash);
+          SDL_FreeSurface(sfc);
+          SDL_FreeSurface(save);
+          return -1;
+        }
+        SDL_SetColorKey(next, GIF_COLORKEY, alpha);
+      }
+      
+      lut = GIF_PaletteMap(raw->img[i].lcolTable == raw->gcolTable ? &gpal
+                                                                   : &lpal,
+                           raw->img[i].lcolTable, raw->img[i].nlcol);
+      if (i > 0 && GIF_SamePixels(&raw->img[i], &raw->img[i - 1])) {
+        hash[i] = GIF_Reshade(sfc, next, &raw->img[i], lut);
+      }
+      else {
+        if (raw->img[i].interlace)
+          GIF_RenderInterlace(&raw->img[i], sfc, lut);
+        else
+          GIF_BlitDispMethod1(sfc, &raw->img[i], lut);
+        
+        SDL_FillRect(next, NULL, alpha);
+        SDL_BlitSurface(sfc, NULL, next, NULL);
+        hash[i] = GIF_HashSurface(next);
+      }
+      
+      /* Keep a single surface for identical frames */
+      for (j = 0; j < i; j++) {
+        if (hash[j] == hash[i] && GIF_SameSurface(gif->images[j], next)) {
+          GIF_ShareFrame(gif, i, j);
+          break;
+        }
+      }
+      if (j == i) {
+        gif->images[i] = next;
+        next = NULL;
+      }
+    }
+    
+//    {
+//      SDL_Surface * screen = SDL_GetVideoSurface();
+//      
+//      SDL_FillRect(screen, NULL, 0xFF00FF00);
+//      SDL_BlitSurface(gif->images[i], NULL, screen, NULL);
+//      SDL_Flip(screen);
+//      SDL_Delay(1000);
+//      
+//      
+//    }
+    
+    switch (raw->img[i].dispMeth) {
+      case 0:
+      case 1:
+      default:
+        break;
+      
+      case 2:
+        r.x = raw->img[i].imgLftPos;
+        r.y = raw->img[i].imgTopPos;
+        r.w = raw->img[i].imgWidth;
+        r.h = raw->img[i].imgHeight;
+        col = alpha;
+      
+        GIF_BlitDispMethod2(sfc, &r, col);
+        break;
+      
+      case 3:
+        r.x = raw->img[i].imgLftPos;
+        r.y = raw->img[i].imgTopPos;
+        r.w = raw->img[i].imgWidth;
+        r.h = raw->img[i].imgHeight;
+      
+        GIF_BlitDispMethod3(save, sfc, &r);
+        break;
+    }
+    
+  }
+  
+  free(hash);
+  SDL_FreeSurface(next);
+  SDL_FreeSurface(sfc);
+  SDL_FreeSurface(save);
+  
+  return 0;
+}
+
+Sint8 GIF_InitFrames(GIF_Raw * raw, GIF_Surface * gif) {
+  Uint32 i;
+  
+  gif->i = 0;
+  gif->tnxt = 0;
+  gif->nimg = raw->i;
+  
+  gif->delays = malloc(gif->nimg * sizeof *gif->delays);
+  if (gif->delays == NULL)
+    return -1;
+  
+  for (i = 0; i < gif->nimg; i++)
+    gif->delays[i] = raw->img[i].delay;
+  
+  /* Indexed frames are expanded on demand, no surface per frame */
+  gif->images = NULL;
+  if (gif->store != NULL)
+    return 0;
+  
+  /* The surfaces are made by GIF_RenderFrames, only for the frames that
+   * aren't shared
+   */
+  gif->images = calloc(gif->nimg, sizeof *gif->images);
+  if (gif->images == NULL)
+    return -1;
+  
+  return 0;
+}
+
+/* A frame is RLE-encoded if at least GIF_RLE_MIN / 256 of it is
+ * transparent : the blits skip the runs of the key instead of testing
+ * every pixel. Its pixels must then be locked to be read, so this is done
+ * once the frames won't be compared any more.
+ */
+enum {
+  GIF_RLE_MIN = 128
+};
+
+void GIF_EncodeFramesRLE(GIF_Surface * gif) {
+  SDL_Surface * sfc;
+  Uint32 * p;
+  Uint64 n;
+  Uint32 i, j, x, y;
+  
+  for (i = 0; i < gif->nimg; i++) {
+    sfc = gif->images[i];
+    
+    /* Shared surfaces are only looked at once */
+    for (j = 0; j < i && gif->images[j] != sfc; j++)
+      ;
+    if (j < i)
+      continue;
+    
+    n = 0;
+    for (y = 0; y < (Uint32)sfc->h; y++) {
+      p = GIF_ROW(sfc, y);
+      for (x = 0; x < (Uint32)sfc->w; x++)
+        n += p[x] == GIF_TRANSPARENT;
+    }
+    
+    if (n * 256 >= (Uint64)sfc->w * sfc->h * GIF_RLE_MIN)
+      SDL_SetColorKey(sfc, GIF_COLORKEY | SDL_RLEACCEL, GIF_TRANSPARENT);
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef GIF_RENDER_H
+#define GIF_RENDER_H
+
+#include "GIF_Struct.h"
+
+/* Every canvas and frame has the same layout : 32 bits, 0x00RRGGBB. The
+ * colors leave the top byte null, so GIF_TRANSPARENT (color key of the
+ * surfaces) can't be taken by a color.
+ * The conversion to the display format is left to the blit on the screen,
+ * SDL only converts if the formats differ.
+ */
+enum {
+  GIF_RMASK = 0x00FF0000,
+  GIF_GMASK = 0x0000FF00,
+  GIF_BMASK = 0x000000FF
+};
+
+#define GIF_TRANSPARENT 0xFF000000
+#define GIF_RGB(r, g, b) ((Uint32)(r) << 16 | (Uint32)(g) << 8 | (Uint32)(b))
+
+/* Row y of a surface created by GIF_CreateRGBSurface */
+#define GIF_ROW(sfc, y) \
+  ((Uint32 *)((Uint8 *)(sfc)->pixels + (Uint32)(y) * (sfc)->pitch))
+
+/* A color table in the layout of the surfaces. It is only converted again
+ * when another table is given, so the frames that share a table (most
+ * often the global one) convert it once. 'cols' is compared by address :
+ * the table mustn't change or be freed while it is the current one.
+ */
+typedef struct {
+  const GIF_Color * cols;   /* Table converted, NULL if none */
+  Uint16 n;
+  Uint32 lut[256];
+} GIF_Palette;
+
+SDL_Surface * GIF_CreateRGBSurface(Uint16 w, Uint16 h);
+const Uint32 * GIF_PaletteMap(GIF_Palette * pal, const GIF_Color * cols,
+                              Uint16 n);
+
+int GIF_SameImage(GIF_Image * a, GIF_Image * b);
+Uint32 GIF_HashSurface(SDL_Surface * sfc);
+int GIF_SameSurface(SDL_Surface * a, SDL_Surface * b);
+
+Uint32 GIF_CountSurfaces(GIF_Raw * raw);
+Sint8 GIF_InitFrames(GIF_Raw * raw, GIF_Surface * gif);
+Sint8 GIF_RenderFrames(GIF_Raw * raw, GIF_Surface * gif);
+void GIF_EncodeFramesRLE(GIF_Surface * gif);
+
+#endif
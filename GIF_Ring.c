@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <SDL.h>
+
+#include "GIF_Ring.h"
+
+
+/* 'head' and 'tail' count pushes and pops since the creation, they only
+ * ever grow (modulo 2^32) and are written by a single side each :
+ * 'head' by the producer, 'tail' by the consumer.
+ * The slot of index i is slots[i & mask].
+ */
+struct GIF_Ring_s {
+  GIF_RingSlot * slots;
+  Uint32 mask;
+  atomic_uint head;
+  atomic_uint tail;
+};
+
+
+/* nslots is rounded up to a power of two */
+GIF_Ring * GIF_Ring_Create(Uint32 nslots) {
+  GIF_Ring * ring;
+  Uint32 n = 1;
+  
+  while (n < nslots)
+    n <<= 1;
+  
+  ring = malloc(sizeof *ring);
+  if (ring == NULL)
+    return NULL;
+  
+  ring->slots = calloc(n, sizeof *ring->slots);
+  if (ring->slots == NULL) {
+    free(ring);
+    return NULL;
+  }
+  
+  ring->mask = n - 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  
+  return ring;
+}
+
+void GIF_Ring_Free(GIF_Ring * ring) {
+  Uint32 i;
+  
+  if (ring == NULL)
+    return;
+  
+  for (i = 0; i <= ring->mask; i++)
+    if (ring->slots[i].sfc != NULL)
+      SDL_FreeSurface(ring->slots[i].sfc);
+  free(ring->slots);
+  free(ring);
+}
+
+
+
+/* #pragma mark Producer */
+
+int GIF_Ring_Full(GIF_Ring * ring) {
+  Uint32 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  Uint32 tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  
+  return head - tail > ring->mask;
+}
+
+/* Slot to fill, only valid if the ring is not full */
+GIF_RingSlot * GIF_Ring_Back(GIF_Ring * ring) {
+  Uint32 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  
+  return &ring->slots[head & ring->mask];
+}
+
+/* Publish the slot given by GIF_Ring_Back */
+void GIF_Ring_Push(GIF_Ring * ring) {
+  Uint32 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+
+
+/* #pragma mark Consumer */
+
+Uint32 GIF_Ring_Count(GIF_Ring * ring) {
+  Uint32 head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  Uint32 tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  
+  return head - tail;
+}
+
+/* Oldest published slot, NULL if the ring is empty */
+GIF_RingSlot * GIF_Ring_Front(GIF_Ring * ring) {
+  Uint32 tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  
+  if (GIF_Ring_Count(ring) == 0)
+    return NULL;
+  
+  return &ring->slots[tail & ring->mask];
+}
+
+/* Give the front slot back to the producer */
+void GIF_Ring_Pop(GIF_Ring * ring) {
+  Uint32 tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
@@ -0,0 +1,32 @@
+#ifndef GIF_RING_H
+#define GIF_RING_H
+
+#include <SDL.h>
+
+/* Fixed-size ring of composited frames shared by one producer (the
+ * decoding thread) and one consumer (GIF_GetNextFrame), without locks.
+ * The front slot is the frame on screen, it stays valid until popped.
+ */
+
+typedef struct {
+  SDL_Surface * sfc;    /* Allocated on first use, reused afterwards */
+  Uint16 delay;
+  Uint32 frame;
+} GIF_RingSlot;
+
+typedef struct GIF_Ring_s GIF_Ring;
+
+GIF_Ring * GIF_Ring_Create(Uint32 nslots);
+void GIF_Ring_Free(GIF_Ring * ring);
+
+/* Producer */
+int GIF_Ring_Full(GIF_Ring * ring);
+GIF_RingSlot * GIF_Ring_Back(GIF_Ring * ring);
+void GIF_Ring_Push(GIF_Ring * ring);
+
+/* Consumer */
+Uint32 GIF_Ring_Count(GIF_Ring * ring);
+GIF_RingSlot * GIF_Ring_Front(GIF_Ring * ring);
+void GIF_Ring_Pop(GIF_Ring * ring);
+
+#endif
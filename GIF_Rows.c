@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Decoder.h"
+#include "GIF_Rows.h"
+
+
+enum {
+  GIF_ROWS_CHUNK = 16384      /* Bytes read from the file at once */
+};
+
+typedef struct {
+  GIF_Decoder * ctx;
+  GIF_RowSink * sink;
+  Uint8 * rgba;       /* w * 4 */
+  Uint16 w;
+  Uint16 h;
+  Uint8 started;      /* 'begin' has been called */
+  Sint8 err;
+} GIF_Rows;
+
+static int GIF_RowsStart(GIF_Rows * r) {
+  r->started = 1;
+  r->w = GIF_DecoderGetWidth(r->ctx);
+  r->h = GIF_DecoderGetHeight(r->ctx);
+  
+  r->rgba = malloc((Uint32)r->w * 4 + 4);
+  if (r->rgba == NULL) {
+    perror("GIF_DecodeRows : malloc");
+    return -1;
+  }
+  
+  if (r->sink->begin != NULL && r->sink->begin(r->sink->data, r->w, r->h) < 0)
+    return -1;
+  return 0;
+}
+
+/* Rows [y0, y1) which the image does not cover */
+static int GIF_RowsBlank(GIF_Rows * r, Uint32 y0, Uint32 y1) {
+  if (y1 > r->h)
+    y1 = r->h;
+  
+  memset(r->rgba, 0, (Uint32)r->w * 4);
+  for (; y0 < y1; y0++)
+    if (r->sink->row(r->sink->data, y0, r->rgba) < 0)
+      return -1;
+  return 0;
+}
+
+static void GIF_RowsFail(GIF_Rows * r) {
+  r->err = 1;
+  GIF_DecoderStop(r->ctx);
+}
+
+
+
+/* #pragma mark Callbacks */
+
+static void GIF_RowsRow(void * data, const GIF_Row * row) {
+  GIF_Rows * r = data;
+  const Uint8 * s = row->idx;
+  const SDL_Color * c;
+  GIF_FrameInfo info;
+  Uint8 * p;
+  Uint32 x, x1;
+  
+  if (r->err)
+    return;
+  
+  /* First row : the rows above the image */
+  if (!r->started) {
+    GIF_DecoderGetFrame(r->ctx, &info);
+    if (GIF_RowsStart(r) < 0 || GIF_RowsBlank(r, 0, info.y) < 0) {
+      GIF_RowsFail(r);
+      return;
+    }
+  }
+  
+  if (row->y >= r->h)
+    return;
+  
+  memset(r->rgba, 0, (Uint32)r->w * 4);
+  x1 = row->x + row->w < r->w ? row->x + row->w : r->w;
+  p = r->rgba + (Uint32)row->x * 4;
+  for (x = row->x; x < x1; x++, s++, p += 4) {
+    if (*s == row->transp)
+      continue;
+    /* Past the color table : black, the row is already null */
+    if (*s < row->ncol) {
+      c = &row->pal[*s];
+      p[0] = c->r;
+      p[1] = c->g;
+      p[2] = c->b;
+    }
+    p[3] = 0xFF;
+  }
+  
+  if (r->sink->row(r->sink->data, row->y, r->rgba) < 0)
+    GIF_RowsFail(r);
+}
+
+/* End of the first image : the rows below it, then stop */
+static void GIF_RowsFrame(void * data, SDL_Surface * canvas, Uint32 frame,
+                          Uint16 delay) {
+  GIF_Rows * r = data;
+  GIF_FrameInfo info;
+  
+  (void)canvas;
+  (void)frame;
+  (void)delay;
+  
+  if (r->err)
+    return;
+  
+  GIF_DecoderGetFrame(r->ctx, &info);
+  if (!r->started) {
+    if (GIF_RowsStart(r) < 0 || GIF_RowsBlank(r, 0, r->h) < 0)
+      GIF_RowsFail(r);
+  }
+  else if (GIF_RowsBlank(r, (Uint32)info.y + info.h, r->h) < 0)
+    GIF_RowsFail(r);
+  
+  GIF_DecoderStop(r->ctx);
+}
+
+
+
+int GIF_DecodeRows(char * file, GIF_RowSink * sink) {
+  GIF_Rows r;
+  Uint8 * buf;
+  FILE * fp;
+  size_t n;
+  int ret = 0;
+  
+  memset(&r, 0, sizeof r);
+  r.sink = sink;
+  
+  fp = fopen(file, "rb");
+  if (fp == NULL) {
+    perror("GIF_DecodeRows : fopen");
+    return -1;
+  }
+  
+  buf = malloc(GIF_ROWS_CHUNK);
+  r.ctx = GIF_DecoderCreate(GIF_DECODER_NOCANVAS, GIF_RowsFrame,
+                            GIF_RowsRow, &r);
+  if (buf == NULL || r.ctx == NULL)
+    ret = -1;
+  
+  while (ret == 0) {
+    n = fread(buf, 1, GIF_ROWS_CHUNK, fp);
+    if (n == 0) {
+      fprintf(stderr, "GIF_DecodeRows : Unexpected end of file.\n");
+      ret = -1;
+      break;
+    }
+    ret = GIF_DecoderPush(r.ctx, buf, n);
+  }
+  
+  /* No image in the file : only the logical screen */
+  if (ret == 1 && !r.err && !r.started &&
+      (GIF_RowsStart(&r) < 0 || GIF_RowsBlank(&r, 0, r.h) < 0))
+    r.err = 1;
+  
+  fclose(fp);
+  free(buf);
+  free(r.rgba);
+  GIF_DecoderFree(r.ctx);
+  
+  return ret < 0 || r.err ? -1 : 0;
+}
+
+
+
+/* #pragma mark Writers */
+
+typedef struct {
+  FILE * fp;
+  Uint8 bpp;          /* 3 for PPM, 4 for raw RGBA */
+  Uint8 * line;
+  Uint32 w;
+  long start;         /* Offset of the first row */
+  Sint32 next;        /* Row following the last one written */
+} GIF_RowWriter;
+
+static int GIF_WriterBegin(void * data, Uint16 w, Uint16 h) {
+  GIF_RowWriter * wr = data;
+  
+  wr->w = w;
+  wr->line = malloc((Uint32)w * wr->bpp + 1);
+  if (wr->line == NULL) {
+    perror("GIF_WriterBegin : malloc");
+    return -1;
+  }
+  
+  if (wr->bpp == 3 && fprintf(wr->fp, "P6\n%u %u\n255\n", w, h) < 0)
+    return -1;
+  wr->start = ftell(wr->fp);
+  return 0;
+}
+
+static int GIF_WriterRow(void * data, Uint16 y, const Uint8 * rgba) {
+  GIF_RowWriter * wr = data;
+  const Uint8 * s = rgba;
+  Uint8 * p = wr->line;
+  Uint32 x;
+  
+  /* Out of order rows : interlaced image */
+  if (y != wr->next &&
+      (wr->start < 0 ||
+       fseek(wr->fp, wr->start + (long)y * wr->w * wr->bpp, SEEK_SET) != 0)) {
+    fprintf(stderr, "GIF_WriterRow : Can't seek in the output.\n");
+    return -1;
+  }
+  wr->next = y + 1;
+  
+  if (wr->bpp == 4)
+    p = (Uint8 *)rgba;
+  else {
+    for (x = 0; x < wr->w; x++, s += 4, p += 3) {
+      p[0] = s[3] ? s[0] : 0;
+      p[1] = s[3] ? s[1] : 0;
+      p[2] = s[3] ? s[2] : 0;
+    }
+    p = wr->line;
+  }
+  
+  if (fwrite(p, wr->bpp, wr->w, wr->fp) != wr->w) {
+    perror("GIF_WriterRow : fwrite");
+    return -1;
+  }
+  return 0;
+}
+
+static int GIF_WriteRows(char * file, char * out, Uint8 bpp) {
+  GIF_RowWriter wr;
+  GIF_RowSink sink;
+  int ret;
+  
+  memset(&wr, 0, sizeof wr);
+  wr.bpp = bpp;
+  wr.fp = fopen(out, "wb");
+  if (wr.fp == NULL) {
+    perror("GIF_WriteRows : fopen");
+    return -1;
+  }
+  
+  sink.begin = GIF_WriterBegin;
+  sink.row = GIF_WriterRow;
+  sink.data = &wr;
+  ret = GIF_DecodeRows(file, &sink);
+  
+  if (fclose(wr.fp) != 0)
+    ret = -1;
+  free(wr.line);
+  
+  return ret;
+}
+
+int GIF_WritePPM(char * file, char * out) {
+  return GIF_WriteRows(file, out, 3);
+}
+
+int GIF_WriteRaw(char * file, char * out) {
+  return GIF_WriteRows(file, out, 4);
+}
@@ -0,0 +1,30 @@
+#ifndef GIF_ROWS_H
+#define GIF_ROWS_H
+
+/* Row streaming of the first image of a file, for very large pictures.
+ * Only the LZW dictionary and a row of the logical screen are kept, the
+ * memory used does not depend on the height of the image.
+ */
+
+/* 'rgba' is a row of the logical screen, 4 bytes per pixel in R, G, B, A
+ * order (pixels outside the image or transparent are 0, 0, 0, 0).
+ * The rows come in increasing order, except in an interlaced image where
+ * they come in the order of the passes. Each row is given once.
+ * The callbacks return -1 to stop the decoding.
+ */
+typedef struct {
+  int (*begin)(void * data, Uint16 w, Uint16 h);
+  int (*row)(void * data, Uint16 y, const Uint8 * rgba);
+  void * data;
+} GIF_RowSink;
+
+/* Return 0, -1 on error */
+int GIF_DecodeRows(char * file, GIF_RowSink * sink);
+
+/* Sinks writing a binary PPM (transparent pixels are black) or the raw RGBA
+ * rows. The rows of an interlaced image are placed with fseek.
+ */
+int GIF_WritePPM(char * file, char * out);
+int GIF_WriteRaw(char * file, char * out);
+
+#endif
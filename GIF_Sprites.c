@@ -0,0 +1,422 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Struct.h"
+#include "GIF_Render.h"
+#include "GIF_Hash.h"
+#include "GIF_Sprites.h"
+
+enum {
+  GIF_SPRITES_PAD = 1,        /* Empty pixels right and below each sprite */
+  GIF_SPRITES_MAXSZ = 16384   /* Largest sheet side */
+};
+
+typedef struct {
+  Uint32 * px;      /* Cropped pixels, NULL if the frame is empty */
+  Uint16 w;
+  Uint16 h;
+  Uint32 hash;
+  Uint16 x;         /* Position in the sheet */
+  Uint16 y;
+} GIF_Sprite;
+
+typedef struct {
+  Uint16 sprite;
+  Uint16 ox;        /* Position in the logical screen */
+  Uint16 oy;
+} GIF_SpriteFrame;
+
+/* Top of the packed sprites from x to x + w */
+typedef struct {
+  Uint32 x;
+  Uint32 y;
+  Uint32 w;
+} GIF_Skyline;
+
+
+
+/* #pragma mark Frames */
+
+/* Crop the frame to its opaque pixels and keep it if it is new.
+ * Return the number of its sprite, -1 on error.
+ */
+static int GIF_Sprites_Add(SDL_Surface * sfc, GIF_Sprite * sprites,
+                           Uint32 * nsprites, GIF_SpriteFrame * frm) {
+  GIF_Sprite s;
+  Uint32 x0 = sfc->w, x1 = 0, y0 = sfc->h, y1 = 0;
+  Uint32 x, y, i;
+  Uint32 * p;
+  
+  for (y = 0; y < (Uint32)sfc->h; y++) {
+    p = GIF_ROW(sfc, y);
+    for (x = 0; x < (Uint32)sfc->w; x++) {
+      if (p[x] != GIF_TRANSPARENT) {
+        if (x < x0)
+          x0 = x;
+        if (x >= x1)
+          x1 = x + 1;
+        if (y < y0)
+          y0 = y;
+        y1 = y + 1;
+      }
+    }
+  }
+  
+  s.px = NULL;
+  s.w = x1 > x0 ? x1 - x0 : 0;
+  s.h = y1 > y0 ? y1 - y0 : 0;
+  s.hash = GIF_HASH_SEED;
+  s.x = s.y = 0;
+  frm->ox = s.w != 0 ? x0 : 0;
+  frm->oy = s.h != 0 ? y0 : 0;
+  
+  if (s.w != 0 && s.h != 0) {
+    s.px = malloc((Uint32)s.w * s.h * sizeof *s.px);
+    if (s.px == NULL) {
+      perror("GIF_WriteSprites : malloc");
+      return -1;
+    }
+    for (y = 0; y < s.h; y++)
+      memcpy(s.px + y * s.w, GIF_ROW(sfc, y0 + y) + x0, s.w * sizeof *s.px);
+    s.hash = GIF_Hash(s.hash, s.px, (Uint32)s.w * s.h * sizeof *s.px);
+  }
+  
+  for (i = 0; i < *nsprites; i++) {
+    if (sprites[i].hash == s.hash && sprites[i].w == s.w &&
+        sprites[i].h == s.h &&
+        (s.px == NULL ||
+         memcmp(sprites[i].px, s.px, (Uint32)s.w * s.h * sizeof *s.px) == 0)) {
+      free(s.px);
+      frm->sprite = i;
+      return i;
+    }
+  }
+  
+  sprites[*nsprites] = s;
+  frm->sprite = *nsprites;
+  return (*nsprites)++;
+}
+
+
+
+/* #pragma mark Packing */
+
+/* Place the sprites, tallest first, in a sheet 'w' pixels wide : each one
+ * goes where its top is the lowest. Return the height used, 0 if a sprite
+ * is wider than the sheet or the sheet gets too high. There must be at
+ * least one sprite to place.
+ */
+static Uint32 GIF_Sprites_Pack(GIF_Sprite * sprites, Uint32 * order,
+                               Uint32 n, Uint32 w, GIF_Skyline * sky) {
+  Uint32 nsky = 1;
+  Uint32 best, bestY, bestX;
+  Uint32 top = 0;
+  Uint32 i, j, k, y, sw, sh, end;
+  GIF_Sprite * s;
+  
+  sky[0].x = 0;
+  sky[0].y = 0;
+  sky[0].w = w;
+  
+  for (k = 0; k < n; k++) {
+    s = &sprites[order[k]];
+    if (s->px == NULL)
+      continue;
+    sw = s->w + GIF_SPRITES_PAD;
+    sh = s->h + GIF_SPRITES_PAD;
+    
+    /* Lowest position, the leftmost one on a tie */
+    best = nsky;
+    bestY = bestX = 0;
+    for (i = 0; i < nsky && sky[i].x + sw <= w; i++) {
+      y = 0;
+      for (j = i; j < nsky && sky[j].x < sky[i].x + sw; j++)
+        if (sky[j].y > y)
+          y = sky[j].y;
+      if (best == nsky || y < bestY) {
+        best = i;
+        bestY = y;
+        bestX = sky[i].x;
+      }
+    }
+    if (best == nsky || bestY + sh > GIF_SPRITES_MAXSZ)
+      return 0;
+    
+    s->x = bestX;
+    s->y = bestY;
+    if (bestY + sh > top)
+      top = bestY + sh;
+    
+    /* The sprite covers the segments under it, the last one is cut */
+    end = bestX + sw;
+    for (j = best; j < nsky && sky[j].x + sky[j].w <= end; j++)
+      ;
+    if (j < nsky && sky[j].x < end) {
+      sky[j].w -= end - sky[j].x;
+      sky[j].x = end;
+    }
+    memmove(&sky[best + 1], &sky[j], (nsky - j) * sizeof *sky);
+    nsky -= j - best - 1;
+    sky[best].x = bestX;
+    sky[best].y = bestY + sh;
+    sky[best].w = sw;
+    
+    /* Merge the neighbours at the same height */
+    for (i = 0, j = 1; j < nsky; j++) {
+      if (sky[j].y == sky[i].y)
+        sky[i].w += sky[j].w;
+      else
+        sky[++i] = sky[j];
+    }
+    nsky = i + 1;
+  }
+  
+  return top;
+}
+
+static Uint32 GIF_Sprites_Pow2(Uint32 n) {
+  Uint32 p = 1;
+  
+  while (p < n)
+    p <<= 1;
+  
+  return p;
+}
+
+/* Pack in the power-of-two sheet of the smallest area.
+ * Return 0, -1 if the sprites don't fit.
+ */
+static Sint8 GIF_Sprites_Layout(GIF_Sprite * sprites, Uint32 n,
+                                Uint32 * sw, Uint32 * sh) {
+  GIF_Skyline * sky;
+  Uint32 * order;
+  Uint32 maxw = 1, bestW = 0, bestH = 0;
+  Uint32 i, j, k, w, h;
+  
+  /* Only empty frames : nothing to place, one transparent pixel */
+  for (i = 0; i < n && sprites[i].px == NULL; i++)
+    ;
+  if (i == n) {
+    *sw = *sh = 1;
+    return 0;
+  }
+  
+  sky = malloc((2 * n + 1) * sizeof *sky);
+  order = malloc((n + 1) * sizeof *order);
+  if (sky == NULL || order == NULL) {
+    perror("GIF_WriteSprites : malloc");
+    free(sky);
+    free(order);
+    return -1;
+  }
+  
+  /* Tallest first */
+  for (i = 0; i < n; i++) {
+    k = i;
+    for (j = i; j > 0 && sprites[order[j - 1]].h < sprites[k].h; j--)
+      order[j] = order[j - 1];
+    order[j] = k;
+    if ((Uint32)sprites[i].w + GIF_SPRITES_PAD > maxw)
+      maxw = sprites[i].w + GIF_SPRITES_PAD;
+  }
+  
+  /* Wider sheets until they get wider than high */
+  for (w = GIF_Sprites_Pow2(maxw); w <= GIF_SPRITES_MAXSZ; w <<= 1) {
+    h = GIF_Sprites_Pack(sprites, order, n, w, sky);
+    if (h == 0)
+      continue;
+    h = GIF_Sprites_Pow2(h);
+    /* The squarest on a tie, for the texture size limits */
+    if (bestW == 0 || (Uint64)w * h < (Uint64)bestW * bestH ||
+        ((Uint64)w * h == (Uint64)bestW * bestH && h > w / 2)) {
+      bestW = w;
+      bestH = h;
+    }
+    if (w >= h)
+      break;
+  }
+  
+  if (bestW != 0)
+    GIF_Sprites_Pack(sprites, order, n, bestW, sky);
+  
+  free(sky);
+  free(order);
+  
+  if (bestW == 0) {
+    fprintf(stderr, "GIF_WriteSprites : Sheet too large.\n");
+    return -1;
+  }
+  *sw = bestW;
+  *sh = bestH;
+  
+  return 0;
+}
+
+
+
+/* #pragma mark Output */
+
+static void GIF_Sprites_Put16(Uint8 * p, Uint16 n) {
+  p[0] = n & 0xFF;
+  p[1] = n >> 8;
+}
+
+static Sint8 GIF_Sprites_WriteSheet(GIF_Sprite * sprites, Uint32 n,
+                                    Uint32 w, Uint32 h, FILE * out,
+                                    Uint32 format) {
+  Uint32 * sheet;
+  Uint8 * row;
+  Uint32 i, x, y, c;
+  Uint8 * q;
+  Sint8 ret = 0;
+  
+  sheet = malloc((size_t)w * h * sizeof *sheet);
+  row = malloc(w * 4);
+  if (sheet == NULL || row == NULL) {
+    perror("GIF_WriteSprites : malloc");
+    free(sheet);
+    free(row);
+    return -1;
+  }
+  
+  for (i = 0; i < w * h; i++)
+    sheet[i] = GIF_TRANSPARENT;
+  for (i = 0; i < n; i++)
+    for (y = 0; y < sprites[i].h; y++)
+      memcpy(sheet + (sprites[i].y + y) * w + sprites[i].x,
+             sprites[i].px + y * sprites[i].w,
+             sprites[i].w * sizeof *sheet);
+  
+  if (format == GIF_SPRITES_PPM)
+    fprintf(out, "P6\n%u %u\n255\n", w, h);
+  
+  for (y = 0; y < h && ret == 0; y++) {
+    q = row;
+    for (x = 0; x < w; x++) {
+      c = sheet[y * w + x];
+      if (c == GIF_TRANSPARENT)
+        c = 0;
+      else if (format == GIF_SPRITES_RGBA)
+        c |= 0xFF000000;
+      *q++ = c >> 16;
+      *q++ = c >> 8;
+      *q++ = c;
+      if (format == GIF_SPRITES_RGBA)
+        *q++ = c >> 24;
+    }
+    if (fwrite(row, 1, q - row, out) != (size_t)(q - row))
+      ret = -1;
+  }
+  
+  free(sheet);
+  free(row);
+  
+  if (ret < 0)
+    fprintf(stderr, "GIF_WriteSprites : fwrite: File error.\n");
+  return ret;
+}
+
+static Sint8 GIF_Sprites_WriteTable(GIF_Surface * gif, GIF_Sprite * sprites,
+                                    GIF_SpriteFrame * frames, Uint32 w,
+                                    Uint32 h, FILE * out) {
+  Uint8 buf[18];
+  GIF_Sprite * s;
+  Uint32 i;
+  
+  memcpy(buf, "GSPR", 4);
+  GIF_Sprites_Put16(buf + 4, w);
+  GIF_Sprites_Put16(buf + 6, h);
+  GIF_Sprites_Put16(buf + 8, gif->w);
+  GIF_Sprites_Put16(buf + 10, gif->h);
+  GIF_Sprites_Put16(buf + 12, gif->nimg & 0xFFFF);
+  GIF_Sprites_Put16(buf + 14, gif->nimg >> 16);
+  if (fwrite(buf, 1, 16, out) != 16)
+    goto error;
+  
+  for (i = 0; i < gif->nimg; i++) {
+    s = &sprites[frames[i].sprite];
+    GIF_Sprites_Put16(buf, frames[i].sprite);
+    GIF_Sprites_Put16(buf + 2, s->px != NULL ? s->x : 0);
+    GIF_Sprites_Put16(buf + 4, s->px != NULL ? s->y : 0);
+    GIF_Sprites_Put16(buf + 6, s->w);
+    GIF_Sprites_Put16(buf + 8, s->h);
+    GIF_Sprites_Put16(buf + 10, frames[i].ox);
+    GIF_Sprites_Put16(buf + 12, frames[i].oy);
+    GIF_Sprites_Put16(buf + 14, gif->delays[i]);
+    GIF_Sprites_Put16(buf + 16, 0);
+    if (fwrite(buf, 1, 18, out) != 18)
+      goto error;
+  }
+  
+  return 0;
+  
+  error:
+  fprintf(stderr, "GIF_WriteSprites : fwrite: File error.\n");
+  return -1;
+}
+
+
+
+int GIF_WriteSprites(GIF_Surface * gif, FILE * sheet, FILE * table,
+                     Uint32 format, Uint16 * w, Uint16 * h) {
+  GIF_SpriteFrame * frames;
+  GIF_Sprite * sprites;
+  SDL_Surface * sfc;
+  Uint32 nsprites = 0;
+  Uint32 sw = 0, sh = 0;
+  Uint32 i;
+  int k;
+  int ret = -1;
+  
+  if (gif->ring != NULL || GIF_GetLoadState(gif) != GIF_LOADED) {
+    fprintf(stderr, "GIF_WriteSprites : Every frame must be loaded.\n");
+    return -1;
+  }
+  if (gif->nimg > 0xFFFF) {
+    fprintf(stderr, "GIF_WriteSprites : Too many frames.\n");
+    return -1;
+  }
+  
+  sprites = malloc((gif->nimg + 1) * sizeof *sprites);
+  frames = malloc((gif->nimg + 1) * sizeof *frames);
+  if (sprites == NULL || frames == NULL) {
+    perror("GIF_WriteSprites : malloc");
+    goto end;
+  }
+  
+  for (i = 0; i < gif->nimg; i++) {
+    sfc = GIF_GetFrame(gif, i);
+    if (sfc == NULL)
+      goto end;
+    if (SDL_MUSTLOCK(sfc))
+      SDL_LockSurface(sfc);
+    k = GIF_Sprites_Add(sfc, sprites, &nsprites, &frames[i]);
+    if (SDL_MUSTLOCK(sfc))
+      SDL_UnlockSurface(sfc);
+    if (k < 0)
+      goto end;
+  }
+  
+  if (GIF_Sprites_Layout(sprites, nsprites, &sw, &sh) < 0 ||
+      GIF_Sprites_WriteSheet(sprites, nsprites, sw, sh, sheet, format) < 0 ||
+      GIF_Sprites_WriteTable(gif, sprites, frames, sw, sh, table) < 0)
+    goto end;
+  
+  if (w != NULL)
+    *w = sw;
+  if (h != NULL)
+    *h = sh;
+  ret = nsprites;
+  
+  end:
+  if (sprites != NULL)
+    for (i = 0; i < nsprites; i++)
+      free(sprites[i].px);
+  free(sprites);
+  free(frames);
+  
+  return ret;
+}
@@ -0,0 +1,39 @@
+#ifndef GIF_SPRITES_H
+#define GIF_SPRITES_H
+
+#include "GIF.h"
+
+/* Sprite sheet of a loaded animation : each composited frame is cropped to
+ * its opaque pixels, identical crops are kept once, then packed in a
+ * power-of-two sheet (skyline, bottom-left). Transparent pixels are null.
+ */
+
+enum {
+  GIF_SPRITES_RGBA,   /* Raw sheet, 4 bytes per pixel in R, G, B, A order */
+  GIF_SPRITES_PPM     /* Binary PPM, transparent pixels are black */
+};
+
+/* Frame table, integers are little-endian :
+ * -> 4 bytes : "GSPR"
+ * -> 2 bytes : Sheet width
+ * -> 2 bytes : Sheet height
+ * -> 2 bytes : Logical screen width
+ * -> 2 bytes : Logical screen height
+ * -> 4 bytes : Number of frames
+ *
+ * -> 18 bytes per frame :
+ *    - 2 bytes : Sprite number (shared by identical frames)
+ *    - 8 bytes : x, y, width, height of the sprite in the sheet
+ *    - 4 bytes : x, y of the sprite in the logical screen
+ *    - 2 bytes : Delay (1/100 s)
+ *    - 2 bytes : Reserved, 0
+ * An empty frame has a null width and height.
+ */
+
+/* 'w' and 'h' get the size of the sheet, they can be NULL.
+ * Return the number of sprites, -1 on error.
+ */
+int GIF_WriteSprites(GIF_Surface * gif, FILE * sheet, FILE * table,
+                     Uint32 format, Uint16 * w, Uint16 * h);
+
+#endif
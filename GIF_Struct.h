@@ -3,6 +3,8 @@
 
 #include <SDL.h>
 
+#include "GIF.h"
+
 enum {
   GIF_87A = 1,
   GIF_89A = 2,
@@ -17,9 +19,15 @@ typedef struct {
   Uint16 imgWidth;
   Uint16 imgHeight;
   GIF_Color * lcolTable;
+  Uint16 nlcol;         /* Number of colors in 'lcolTable' */
   Uint32 interlace    : 1;
+  Uint32 shared       : 1;  /* 'data' belongs to a previous image */
   Uint16 * data;
   
+  Uint32 hash;          /* Hash of the compressed data and its size */
+  Uint8 * lzw;          /* Compressed data, only valid while loading */
+  Uint32 lzwSz;
+  
   Uint32 dispMeth     : 3;
   Uint32 userInput    : 1;
   Uint32 transpColor  : 1;
@@ -34,13 +42,76 @@ typedef struct {
   Uint16 h;
   Uint8 bckColIndex;
   GIF_Color * gcolTable;
+  Uint16 ngcol;         /* Number of colors in 'gcolTable' */
   GIF_Image * img;
   
   Uint32 i;
   
+  Uint64 mem;           /* Bytes of the decoded images */
+  Uint64 budget;        /* Memory budget of the load, 0 if none */
+  Uint8 over;           /* Parsing stopped by 'budget' */
 } GIF_Raw;
 
+struct GIF_Surface_s {
+  SDL_Surface ** images;
+  Uint16 * delays;
+  Uint32 nimg;
+  Uint32 i;
+  
+  Uint32 tnxt;
+  
+	Uint16 w;
+	Uint16 h;
+  
+  struct GIF_IndexStore_s * store;  /* Indexed frames, 'images' is unused */
+  
+  /* Background loading (GIF_LoadGIFAsync), 'lock' is NULL otherwise */
+  SDL_Thread * thread;
+  SDL_mutex * lock;     /* Protects the fields above while loading */
+  Uint32 cap;           /* Allocated entries of 'images' and 'delays' */
+  Uint8 state;          /* GIF_LOADING, GIF_LOADED or GIF_FAILED */
+  Uint8 cancel;         /* Asks the thread to stop */
+  char * file;
+  GIF_LoadFunc done;
+  void * data;
+  
+  struct GIF_Ring_s * ring;   /* GIF_LOAD_STREAM, 'images' is unused */
+  
+  Uint64 budget;        /* Memory budget of the load, 0 if none */
+  Uint64 mem;           /* Bytes of the frames received by the thread */
+  Uint8 over;           /* A frame didn't fit in 'budget' */
+  Uint8 failed;         /* A frame couldn't be kept */
+};
+
+
+/* The library builds with SDL 1.2 and SDL 2 */
+#if SDL_MAJOR_VERSION >= 2
+# define GIF_COLORKEY SDL_TRUE
+# define GIF_CreateThread(f, name, data) SDL_CreateThread(f, name, data)
+#else
+# define GIF_COLORKEY SDL_SRCCOLORKEY
+# define GIF_CreateThread(f, name, data) SDL_CreateThread(f, data)
+#endif
+
+/* The parse cursor is per thread so that files can load concurrently */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+# define GIF_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+# define GIF_THREAD_LOCAL __declspec(thread)
+#else
+# define GIF_THREAD_LOCAL __thread
+#endif
+
+extern GIF_THREAD_LOCAL Uint8 * pdata;
+
+/* A loaded file is followed by GIF_PAD null bytes : a color table (768
+ * bytes) or a sub-block (256 bytes) read past 'pend' stays in them and
+ * ends on a null length, so the end is checked once per block.
+ */
+enum {
+  GIF_PAD = 1024
+};
 
-Uint8 * pdata;
+extern GIF_THREAD_LOCAL Uint8 * pend;
 
 #endif
@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Decoder.h"
+#include "GIF_Thumb.h"
+
+
+enum {
+  GIF_THUMB_CHUNK = 16384     /* Bytes read from the file at once */
+};
+
+/* Area filter : the source pixel (x, y) falls in the thumbnail pixel
+ * (xmap[x], ymap[y]), each thumbnail pixel is the mean of its box.
+ * The thumbnail is kept with premultiplied alpha so that transparent
+ * pixels, and boxes partly covered by a frame, blend right.
+ */
+typedef struct {
+  GIF_Decoder * ctx;
+  GIF_ThumbFunc f;
+  void * data;
+  Uint32 nframes;
+  Uint32 done;
+  
+  Uint16 sw;          /* Logical screen */
+  Uint16 sh;
+  Uint16 tw;          /* Thumbnail */
+  Uint16 th;
+  Uint16 * xmap;
+  Uint16 * ymap;
+  Uint32 * bw;        /* Source columns in each thumbnail column */
+  Uint32 * bh;
+  
+  float * canvas;     /* tw * th * 4 : premultiplied R, G, B and A */
+  float * save;       /* Canvas before a frame with disposal method 3 */
+  Uint8 * out;
+  
+  /* Frame being decoded, blended in 'canvas' once it is complete so that
+   * the interlaced passes don't overlap */
+  float * sum;        /* tw * th * 3 : colors of the opaque pixels */
+  Uint32 * cnt;       /* Opaque pixels in each box */
+  
+  Sint32 frame;       /* Frame of the last row */
+  GIF_FrameInfo info;
+  Uint16 size;
+  Sint8 err;
+} GIF_Thumb;
+
+
+
+static int GIF_ThumbInit(GIF_Thumb * t) {
+  Uint16 size = t->size;
+  Uint32 i;
+  
+  t->sw = GIF_DecoderGetWidth(t->ctx);
+  t->sh = GIF_DecoderGetHeight(t->ctx);
+  if (t->sw == 0 || t->sh == 0)
+    return -1;
+  
+  if (t->sw <= size && t->sh <= size) {
+    t->tw = t->sw;
+    t->th = t->sh;
+  }
+  else if (t->sw >= t->sh) {
+    t->tw = size;
+    t->th = (t->sh * size + t->sw / 2) / t->sw;
+  }
+  else {
+    t->th = size;
+    t->tw = (t->sw * size + t->sh / 2) / t->sh;
+  }
+  if (t->tw == 0)
+    t->tw = 1;
+  if (t->th == 0)
+    t->th = 1;
+  
+  t->xmap = malloc(t->sw * sizeof *t->xmap);
+  t->ymap = malloc(t->sh * sizeof *t->ymap);
+  t->bw = calloc(t->tw, sizeof *t->bw);
+  t->bh = calloc(t->th, sizeof *t->bh);
+  t->canvas = calloc((Uint32)t->tw * t->th * 4, sizeof *t->canvas);
+  t->out = malloc((Uint32)t->tw * t->th * 4);
+  t->sum = calloc((Uint32)t->tw * t->th * 3, sizeof *t->sum);
+  t->cnt = calloc((Uint32)t->tw * t->th, sizeof *t->cnt);
+  if (t->xmap == NULL || t->ymap == NULL || t->bw == NULL ||
+      t->bh == NULL || t->canvas == NULL || t->out == NULL ||
+      t->sum == NULL || t->cnt == NULL)
+    return -1;
+  
+  for (i = 0; i < t->sw; i++) {
+    t->xmap[i] = i * t->tw / t->sw;
+    t->bw[t->xmap[i]]++;
+  }
+  for (i = 0; i < t->sh; i++) {
+    t->ymap[i] = i * t->th / t->sh;
+    t->bh[t->ymap[i]]++;
+  }
+  
+  return 0;
+}
+
+static void GIF_ThumbFree(GIF_Thumb * t) {
+  free(t->xmap);
+  free(t->ymap);
+  free(t->bw);
+  free(t->bh);
+  free(t->canvas);
+  free(t->save);
+  free(t->out);
+  free(t->sum);
+  free(t->cnt);
+}
+
+/* Blend the accumulated frame in the thumbnail : the frame replaces the
+ * fraction of each box it covers with opaque pixels.
+ */
+static void GIF_ThumbFlush(GIF_Thumb * t) {
+  float * p = t->canvas;
+  float * s = t->sum;
+  float a, f;
+  Uint32 x, y, k = 0;
+  
+  for (y = 0; y < t->th; y++) {
+    for (x = 0; x < t->tw; x++, k++, p += 4, s += 3) {
+      if (t->cnt[k] == 0)
+        continue;
+      a = (float)t->bw[x] * t->bh[y];
+      f = t->cnt[k] / a;
+      p[0] = p[0] * (1 - f) + s[0] / a;
+      p[1] = p[1] * (1 - f) + s[1] / a;
+      p[2] = p[2] * (1 - f) + s[2] / a;
+      p[3] = p[3] * (1 - f) + f;
+      s[0] = s[1] = s[2] = 0;
+      t->cnt[k] = 0;
+    }
+  }
+}
+
+/* Disposal of the frame which has just been given, in thumbnail space :
+ * each box loses the fraction covered by the frame.
+ */
+static void GIF_ThumbDispose(GIF_Thumb * t) {
+  GIF_FrameInfo * fr = &t->info;
+  Uint32 x, y, x0, x1, y0, y1, i, k;
+  float f;
+  
+  if (fr->dispMeth != 2 && (fr->dispMeth != 3 || t->save == NULL))
+    return;
+  
+  x0 = fr->x < t->sw ? fr->x : t->sw;
+  y0 = fr->y < t->sh ? fr->y : t->sh;
+  x1 = fr->x + fr->w < t->sw ? fr->x + fr->w : t->sw;
+  y1 = fr->y + fr->h < t->sh ? fr->y + fr->h : t->sh;
+  if (x0 >= x1 || y0 >= y1)
+    return;
+  
+  /* Columns of the rectangle in each box, 'cnt' is free after a flush */
+  memset(t->cnt, 0, t->tw * sizeof *t->cnt);
+  for (i = x0; i < x1; i++)
+    t->cnt[t->xmap[i]]++;
+  
+  for (y = t->ymap[y0]; y <= t->ymap[y1 - 1]; y++) {
+    for (k = 0, i = y0; i < y1; i++)
+      k += t->ymap[i] == y;
+    
+    for (x = t->xmap[x0]; x <= t->xmap[x1 - 1]; x++) {
+      f = (float)t->cnt[x] * k / ((float)t->bw[x] * t->bh[y]);
+      for (i = (y * t->tw + x) * 4; i < (y * t->tw + x) * 4 + 4; i++) {
+        t->canvas[i] *= 1 - f;
+        if (fr->dispMeth == 3)
+          t->canvas[i] += t->save[i] * f;
+      }
+    }
+  }
+  memset(t->cnt, 0, t->tw * sizeof *t->cnt);
+}
+
+
+
+/* #pragma mark Callbacks */
+
+static void GIF_ThumbRow(void * data, const GIF_Row * row) {
+  GIF_Thumb * t = data;
+  const Uint8 * s = row->idx;
+  const SDL_Color * c;
+  Uint32 x, x1, k;
+  Uint32 n = (Uint32)t->tw * t->th * 4;
+  float * sum;
+  Uint32 * cnt;
+  
+  if (t->err)
+    return;
+  
+  /* The logical screen is known from the first row */
+  if (t->canvas == NULL && GIF_ThumbInit(t) < 0) {
+    fprintf(stderr, "GIF_Thumbnail : Can't allocate the thumbnail.\n");
+    t->err = 1;
+    GIF_DecoderStop(t->ctx);
+    return;
+  }
+  
+  /* First row of a frame */
+  if ((Sint32)row->frame != t->frame) {
+    t->frame = row->frame;
+    GIF_DecoderGetFrame(t->ctx, &t->info);
+    if (t->info.dispMeth == 3) {
+      if (t->save == NULL)
+        t->save = malloc(n * sizeof *t->save);
+      if (t->save != NULL)
+        memcpy(t->save, t->canvas, n * sizeof *t->save);
+    }
+  }
+  
+  if (row->y >= t->sh)
+    return;
+  
+  k = (Uint32)t->ymap[row->y] * t->tw;
+  sum = t->sum + k * 3;
+  cnt = t->cnt + k;
+  
+  x1 = row->x + row->w < t->sw ? row->x + row->w : t->sw;
+  for (x = row->x; x < x1; x++, s++) {
+    if (*s == row->transp)
+      continue;
+    k = t->xmap[x];
+    if (*s < row->ncol) {
+      c = &row->pal[*s];
+      sum[3 * k] += c->r;
+      sum[3 * k + 1] += c->g;
+      sum[3 * k + 2] += c->b;
+    }
+    cnt[k]++;
+  }
+}
+
+static void GIF_ThumbFrame(void * data, SDL_Surface * canvas, Uint32 frame,
+                           Uint16 delay) {
+  GIF_Thumb * t = data;
+  const float * p = t->canvas;
+  Uint8 * q = t->out;
+  Uint32 i, n = (Uint32)t->tw * t->th;
+  
+  (void)canvas;
+  
+  /* A frame without any row is left as is */
+  if (t->err || t->canvas == NULL)
+    return;
+  
+  GIF_ThumbFlush(t);
+  
+  for (i = 0; i < n; i++, p += 4, q += 4) {
+    if (p[3] < 1.0f / 512) {
+      q[0] = q[1] = q[2] = q[3] = 0;
+      continue;
+    }
+    q[0] = p[0] / p[3] + 0.5f;
+    q[1] = p[1] / p[3] + 0.5f;
+    q[2] = p[2] / p[3] + 0.5f;
+    q[3] = p[3] * 255 + 0.5f;
+  }
+  
+  t->f(t->data, t->out, t->tw, t->th, frame, delay);
+  
+  if (++t->done == t->nframes) {
+    GIF_DecoderStop(t->ctx);
+    return;
+  }
+  
+  GIF_DecoderGetFrame(t->ctx, &t->info);
+  GIF_ThumbDispose(t);
+}
+
+
+
+int GIF_ThumbnailEx(GIF_Decoder * ctx, Uint8 * buf, Uint32 bufsz,
+                    char * file, Uint16 size, Uint32 nframes,
+                    GIF_ThumbFunc f, void * data) {
+  GIF_Thumb t;
+  FILE * fp;
+  size_t n;
+  int ret = 0;
+  
+  if (size == 0 || nframes == 0)
+    return 0;
+  
+  memset(&t, 0, sizeof t);
+  t.ctx = ctx;
+  t.f = f;
+  t.data = data;
+  t.nframes = nframes;
+  t.frame = -1;
+  t.size = size;
+  
+  fp = fopen(file, "rb");
+  if (fp == NULL)
+    return -1;
+  
+  GIF_DecoderReset(ctx);
+  GIF_DecoderSetCallbacks(ctx, GIF_DECODER_NOCANVAS, GIF_ThumbFrame,
+                          GIF_ThumbRow, &t);
+  
+  while (ret == 0) {
+    n = fread(buf, 1, bufsz, fp);
+    if (n == 0) {
+      fprintf(stderr, "GIF_Thumbnail : Unexpected end of file.\n");
+      ret = -1;
+      break;
+    }
+    ret = GIF_DecoderPush(ctx, buf, n);
+  }
+  
+  fclose(fp);
+  GIF_DecoderSetCallbacks(ctx, GIF_DECODER_NOCANVAS, NULL, NULL, NULL);
+  GIF_ThumbFree(&t);
+  
+  if (t.err || (ret < 0 && t.done == 0))
+    return -1;
+  return t.done;
+}
+
+int GIF_Thumbnail(char * file, Uint16 size, Uint32 nframes,
+                  GIF_ThumbFunc f, void * data) {
+  GIF_Decoder * ctx;
+  Uint8 * buf;
+  int ret = -1;
+  
+  buf = malloc(GIF_THUMB_CHUNK);
+  ctx = GIF_DecoderCreate(GIF_DECODER_NOCANVAS, NULL, NULL, NULL);
+  if (buf != NULL && ctx != NULL)
+    ret = GIF_ThumbnailEx(ctx, buf, GIF_THUMB_CHUNK, file, size, nframes,
+                          f, data);
+  
+  free(buf);
+  GIF_DecoderFree(ctx);
+  
+  return ret;
+}
@@ -0,0 +1,28 @@
+#ifndef GIF_THUMB_H
+#define GIF_THUMB_H
+
+/* Thumbnails of the first frames of a file. The frames are composited
+ * straight at the size of the thumbnail, the file is not read further than
+ * the last frame asked.
+ */
+
+#include "GIF_Decoder.h"
+
+/* 'rgba' holds w * h pixels, 4 bytes each in R, G, B, A order */
+typedef void (*GIF_ThumbFunc)(void * data, const Uint8 * rgba,
+                              Uint16 w, Uint16 h, Uint32 frame, Uint16 delay);
+
+/* The longest side of the thumbnail is 'size' (the image is not enlarged).
+ * Return the number of frames given to 'f', -1 on error.
+ */
+int GIF_Thumbnail(char * file, Uint16 size, Uint32 nframes,
+                  GIF_ThumbFunc f, void * data);
+
+/* The same with a decoder and a read buffer of 'bufsz' bytes kept by the
+ * caller from one file to the next. The decoder is left without callbacks.
+ */
+int GIF_ThumbnailEx(GIF_Decoder * ctx, Uint8 * buf, Uint32 bufsz,
+                    char * file, Uint16 size, Uint32 nframes,
+                    GIF_ThumbFunc f, void * data);
+
+#endif
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Render.h"
+#include "GIF_Decoder.h"
+#include "GIF_Video.h"
+
+
+enum {
+  GIF_VIDEO_CHUNK = 16384     /* Bytes read from the file at once */
+};
+
+typedef struct {
+  GIF_Decoder * ctx;
+  FILE * out;
+  Uint32 format;
+  Uint16 fps;
+  Uint16 w;
+  Uint16 h;
+  
+  Uint64 t;           /* End of the last GIF frame (1/100 s) */
+  Uint32 n;           /* Video frames written */
+  
+  Uint8 * frame;      /* Converted frame */
+  Uint32 sz;          /* Size of 'frame' */
+  Uint8 * rgb;        /* Two rows of R, G and B, w + 1 bytes each */
+  Sint8 err;
+} GIF_Video;
+
+
+
+/* #pragma mark Conversion */
+
+/* Unpack a row of the canvas in separate planes, the transparent pixels
+ * are black. An odd row is padded with its last pixel.
+ */
+static void GIF_VideoUnpack(SDL_Surface * sfc, Uint16 y, Uint8 * r, Uint8 * g,
+                            Uint8 * b, Uint8 * a) {
+  Uint32 * p = GIF_ROW(sfc, y);
+  Uint32 x, c;
+  
+  for (x = 0; x < (Uint32)sfc->w; x++) {
+    c = p[x];
+    if (c == GIF_TRANSPARENT) {
+      r[x] = g[x] = b[x] = 0;
+      if (a != NULL)
+        a[x] = 0;
+      continue;
+    }
+    r[x] = c >> 16;
+    g[x] = c >> 8;
+    b[x] = c;
+    if (a != NULL)
+      a[x] = 0xFF;
+  }
+  
+  r[x] = r[x - 1];
+  g[x] = g[x - 1];
+  b[x] = b[x - 1];
+}
+
+/* BT.601, limited range, 8 bits of fraction. The loops have no branch so
+ * that the compiler can vectorize them.
+ */
+static void GIF_VideoLuma(const Uint8 * r, const Uint8 * g, const Uint8 * b,
+                          Uint8 * y, Uint32 w) {
+  Uint32 x;
+  
+  for (x = 0; x < w; x++)
+    y[x] = ((66 * r[x] + 129 * g[x] + 25 * b[x] + 128) >> 8) + 16;
+}
+
+/* Mean of each 2x2 block of the two rows */
+static void GIF_VideoChroma(const Uint8 * r, const Uint8 * g,
+                            const Uint8 * b, Uint32 pitch, Uint8 * u,
+                            Uint8 * v, Uint32 cw) {
+  Sint32 sr, sg, sb;
+  Uint32 x, k;
+  
+  for (x = 0; x < cw; x++) {
+    k = 2 * x;
+    sr = (r[k] + r[k + 1] + r[pitch + k] + r[pitch + k + 1] + 2) >> 2;
+    sg = (g[k] + g[k + 1] + g[pitch + k] + g[pitch + k + 1] + 2) >> 2;
+    sb = (b[k] + b[k + 1] + b[pitch + k] + b[pitch + k + 1] + 2) >> 2;
+    u[x] = ((-38 * sr - 74 * sg + 112 * sb + 128) >> 8) + 128;
+    v[x] = ((112 * sr - 94 * sg - 18 * sb + 128) >> 8) + 128;
+  }
+}
+
+static void GIF_VideoYUV(GIF_Video * vid, SDL_Surface * sfc) {
+  Uint32 w = vid->w, h = vid->h;
+  Uint32 cw = (w + 1) / 2, ch = (h + 1) / 2;
+  Uint32 pitch = w + 1;
+  Uint8 * r = vid->rgb;
+  Uint8 * g = r + 2 * pitch;
+  Uint8 * b = g + 2 * pitch;
+  Uint8 * y = vid->frame;
+  Uint8 * u = y + w * h;
+  Uint8 * v = u + cw * ch;
+  Uint32 k;
+  
+  for (k = 0; k < h; k += 2, y += 2 * w, u += cw, v += cw) {
+    GIF_VideoUnpack(sfc, k, r, g, b, NULL);
+    GIF_VideoLuma(r, g, b, y, w);
+    
+    /* An odd last row is paired with itself */
+    if (k + 1 < h) {
+      GIF_VideoUnpack(sfc, k + 1, r + pitch, g + pitch, b + pitch, NULL);
+      GIF_VideoLuma(r + pitch, g + pitch, b + pitch, y + w, w);
+    }
+    else {
+      memcpy(r + pitch, r, pitch);
+      memcpy(g + pitch, g, pitch);
+      memcpy(b + pitch, b, pitch);
+    }
+    
+    GIF_VideoChroma(r, g, b, pitch, u, v, cw);
+  }
+}
+
+static void GIF_VideoRGBA(GIF_Video * vid, SDL_Surface * sfc) {
+  Uint32 w = vid->w;
+  Uint8 * r = vid->rgb;
+  Uint8 * g = r + w + 1;
+  Uint8 * b = g + w + 1;
+  Uint8 * a = b + w + 1;
+  Uint8 * p = vid->frame;
+  Uint32 x, y;
+  
+  for (y = 0; y < vid->h; y++) {
+    GIF_VideoUnpack(sfc, y, r, g, b, a);
+    for (x = 0; x < w; x++, p += 4) {
+      p[0] = r[x];
+      p[1] = g[x];
+      p[2] = b[x];
+      p[3] = a[x];
+    }
+  }
+}
+
+
+
+/* #pragma mark Output */
+
+static void GIF_VideoConvert(GIF_Video * vid, SDL_Surface * canvas) {
+  if (SDL_MUSTLOCK(canvas))
+    SDL_LockSurface(canvas);
+  if (vid->format == GIF_VIDEO_Y4M)
+    GIF_VideoYUV(vid, canvas);
+  else
+    GIF_VideoRGBA(vid, canvas);
+  if (SDL_MUSTLOCK(canvas))
+    SDL_UnlockSurface(canvas);
+}
+
+static int GIF_VideoInit(GIF_Video * vid) {
+  Uint32 cw;
+  
+  vid->w = GIF_DecoderGetWidth(vid->ctx);
+  vid->h = GIF_DecoderGetHeight(vid->ctx);
+  if (vid->w == 0 || vid->h == 0)
+    return -1;
+  
+  cw = (vid->w + 1) / 2;
+  if (vid->format == GIF_VIDEO_Y4M) {
+    vid->sz = (Uint32)vid->w * vid->h + 2 * cw * ((vid->h + 1) / 2);
+    if (fprintf(vid->out, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n",
+                vid->w, vid->h, vid->fps) < 0)
+      return -1;
+  }
+  else
+    vid->sz = (Uint32)vid->w * vid->h * 4;
+  
+  vid->frame = malloc(vid->sz);
+  vid->rgb = malloc(6 * ((Uint32)vid->w + 1));
+  if (vid->frame == NULL || vid->rgb == NULL) {
+    perror("GIF_WriteVideo : malloc");
+    return -1;
+  }
+  
+  return 0;
+}
+
+static int GIF_VideoWrite(GIF_Video * vid) {
+  if (vid->format == GIF_VIDEO_Y4M && fputs("FRAME\n", vid->out) < 0)
+    return -1;
+  if (fwrite(vid->frame, 1, vid->sz, vid->out) != vid->sz) {
+    perror("GIF_WriteVideo : fwrite");
+    return -1;
+  }
+  vid->n++;
+  return 0;
+}
+
+/* The video frame n is shown at n / fps : it is the GIF frame covering
+ * that time. A GIF frame is written as many times as there are video
+ * frames in [t, t + delay), none if it is too short.
+ */
+static void GIF_VideoFrame(void * data, SDL_Surface * canvas, Uint32 frame,
+                           Uint16 delay) {
+  GIF_Video * vid = data;
+  Uint8 conv = 0;
+  
+  (void)frame;
+  
+  if (vid->err)
+    return;
+  
+  if (vid->frame == NULL && GIF_VideoInit(vid) < 0) {
+    vid->err = 1;
+    GIF_DecoderStop(vid->ctx);
+    return;
+  }
+  
+  vid->t += delay;
+  while ((Uint64)vid->n * 100 < vid->t * vid->fps) {
+    if (!conv) {
+      GIF_VideoConvert(vid, canvas);
+      conv = 1;
+    }
+    
+    if (GIF_VideoWrite(vid) < 0) {
+      vid->err = 1;
+      GIF_DecoderStop(vid->ctx);
+      return;
+    }
+  }
+  
+  /* The encoder can start on what has been written */
+  if (conv)
+    fflush(vid->out);
+}
+
+
+
+int GIF_WriteVideo(char * file, FILE * out, Uint32 format, Uint16 fps) {
+  GIF_Video vid;
+  Uint8 * buf;
+  FILE * fp;
+  size_t n;
+  int ret = 0;
+  
+  if (fps == 0) {
+    fprintf(stderr, "GIF_WriteVideo : Bad frame rate.\n");
+    return -1;
+  }
+  
+  memset(&vid, 0, sizeof vid);
+  vid.out = out;
+  vid.format = format;
+  vid.fps = fps;
+  
+  fp = fopen(file, "rb");
+  if (fp == NULL) {
+    perror("GIF_WriteVideo : fopen");
+    return -1;
+  }
+  
+  buf = malloc(GIF_VIDEO_CHUNK);
+  vid.ctx = GIF_DecoderCreate(0, GIF_VideoFrame, NULL, &vid);
+  if (buf == NULL || vid.ctx == NULL)
+    ret = -1;
+  
+  while (ret == 0) {
+    n = fread(buf, 1, GIF_VIDEO_CHUNK, fp);
+    if (n == 0) {
+      fprintf(stderr, "GIF_WriteVideo : Unexpected end of file.\n");
+      ret = -1;
+      break;
+    }
+    ret = GIF_DecoderPush(vid.ctx, buf, n);
+  }
+  
+  /* Every delay is 0 : the last frame once */
+  if (ret >= 0 && !vid.err && vid.n == 0 && vid.frame != NULL) {
+    GIF_VideoConvert(&vid, GIF_DecoderGetCanvas(vid.ctx));
+    if (GIF_VideoWrite(&vid) < 0)
+      vid.err = 1;
+  }
+  
+  fclose(fp);
+  free(buf);
+  free(vid.frame);
+  free(vid.rgb);
+  GIF_DecoderFree(vid.ctx);
+  
+  if (fflush(out) != 0 || vid.err || (ret < 0 && vid.n == 0))
+    return -1;
+  return vid.n;
+}
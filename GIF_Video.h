@@ -0,0 +1,17 @@
+#ifndef GIF_VIDEO_H
+#define GIF_VIDEO_H
+
+/* Composited frames as a raw video stream for encoders. The frames are
+ * written while the file is decoded, at a constant frame rate : a frame
+ * is repeated or dropped to follow the delays.
+ */
+
+enum {
+  GIF_VIDEO_Y4M,      /* YUV4MPEG2, 4:2:0, BT.601 limited range */
+  GIF_VIDEO_RGBA      /* Raw frames, 4 bytes per pixel in R, G, B, A order */
+};
+
+/* Return the number of frames written, -1 on error */
+int GIF_WriteVideo(char * file, FILE * out, Uint32 format, Uint16 fps);
+
+#endif
@@ -1,86 +1,300 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-
-#include <SDL.h>
-
-#include "GIF.h"
-
-
-enum {
-  SDL_FLAGS = SDL_INIT_VIDEO,
-  WIDTH = 800,
-  HEIGHT = 600,
-  BPP = 32,
-  SFC_FLAGS = SDL_SWSURFACE
-};
-
-
-
-Sint32 init(void) {
-  if (SDL_Init(SDL_FLAGS) < 0) {
-    fprintf(stderr, "SDL_Init : %s\n", SDL_GetError());
-    return -1;
-  }
-  atexit(SDL_Quit);
-  
-  if (SDL_SetVideoMode(WIDTH, HEIGHT, BPP, SFC_FLAGS) == NULL) {
-    fprintf(stderr, "SDL_SetVideoMode : %s\n",
-            SDL_GetError());
-    return -1;
-  }
-  
-  SDL_WM_SetCaption("GIF", NULL);
-  
-  return 0;
-}
-
-int main(int argc, char ** argv) {
-  GIF_Surface * img;
-  SDL_Surface * screen;
-  SDL_Surface * tmp;
-  SDL_Event e;
-  Uint8 done;
-
-  if (argc != 2) {
-    fprintf(stderr, "%s requires one argument.\n", argv[0]);
-    return EXIT_FAILURE;
-  }
-  
-  if (init() < 0)
-    return EXIT_FAILURE;
-
-  img = GIF_LoadGIF(argv[1]);
-  if (img == NULL) {
-    fprintf(stderr, "Error: main: Open file failed !\n");
-    return EXIT_FAILURE;
-  }
-
-	// Resize to match the size of the gif
-  if (SDL_SetVideoMode(GIF_GetWidth(img), GIF_GetHeight(img), BPP, SFC_FLAGS) == NULL) {
-    fprintf(stderr, "SDL_SetVideoMode : %s\n",
-            SDL_GetError());
-    return -1;
-  }
-
-  screen = SDL_GetVideoSurface();
-
-  done = 0;
-  while (!done) {
-    if (SDL_QuitRequested())
-        done = 1;
-    while (SDL_PollEvent(&e)) {
-        if (e.type == SDL_QUIT ||
-           (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE))
-            done = 1;
-    }
-    SDL_FillRect(screen, NULL, 0xFF00FF00);
-    tmp = GIF_GetNextFrame(img);
-    SDL_BlitSurface(tmp, NULL, screen, NULL);
-    SDL_Flip(screen);
-    //SDL_Delay(1);
-  }
-  
-  return EXIT_SUCCESS;
-}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <SDL.h>
+
+#include "GIF.h"
+
+
+/* SDL2 [-novsync] [-b frames] file.gif
+ * Play the animation in a window. The frames go to one streaming texture,
+ * only the rows that changed since the previous frame are uploaded.
+ * With -b, the frames are presented as fast as possible, without vsync,
+ * and the cost of the presentation is printed. It runs headless with
+ * SDL_VIDEODRIVER=dummy (the default) or offscreen.
+ */
+
+enum {
+  SDL_FLAGS = SDL_INIT_VIDEO,
+  WIDTH = 800,
+  HEIGHT = 600,
+  
+  BACKGROUND = 0xFF00FF00,  /* Shown through the transparent pixels */
+  OPAQUE = 0xFF000000       /* Alpha of the texture */
+};
+
+typedef struct {
+  SDL_Window * win;
+  SDL_Renderer * ren;
+  SDL_Texture * tex;
+  Uint32 * prev;        /* Pixels in the texture, to find the changed rows */
+  Uint16 w;
+  Uint16 h;
+  
+  Uint32 rows;          /* Rows uploaded */
+  Uint64 tUpload;       /* Performance counter ticks */
+  Uint64 tPresent;
+} Viewer;
+
+
+
+Sint32 init(Viewer * v, Uint8 vsync) {
+  if (SDL_Init(SDL_FLAGS) < 0) {
+    fprintf(stderr, "SDL_Init : %s\n", SDL_GetError());
+    return -1;
+  }
+  atexit(SDL_Quit);
+  
+  v->win = SDL_CreateWindow("GIF", SDL_WINDOWPOS_UNDEFINED,
+                            SDL_WINDOWPOS_UNDEFINED, WIDTH, HEIGHT, 0);
+  if (v->win == NULL) {
+    fprintf(stderr, "SDL_CreateWindow : %s\n", SDL_GetError());
+    return -1;
+  }
+  
+  v->ren = SDL_CreateRenderer(v->win, -1,
+                              vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+  if (v->ren == NULL) {
+    fprintf(stderr, "SDL_CreateRenderer : %s\n", SDL_GetError());
+    return -1;
+  }
+  
+  return 0;
+}
+
+/* Size the window and the texture to the animation */
+Sint32 resize(Viewer * v, Uint16 w, Uint16 h) {
+  SDL_SetWindowSize(v->win, w, h);
+  
+  v->tex = SDL_CreateTexture(v->ren, SDL_PIXELFORMAT_ARGB8888,
+                             SDL_TEXTUREACCESS_STREAMING, w, h);
+  if (v->tex == NULL) {
+    fprintf(stderr, "SDL_CreateTexture : %s\n", SDL_GetError());
+    return -1;
+  }
+  SDL_SetTextureBlendMode(v->tex, SDL_BLENDMODE_BLEND);
+  
+  /* No frame has this value : the first one is uploaded whole */
+  v->prev = malloc((Uint32)w * h * sizeof *v->prev);
+  if (v->prev == NULL) {
+    perror("resize : malloc");
+    return -1;
+  }
+  memset(v->prev, 0x01, (Uint32)w * h * sizeof *v->prev);
+  
+  v->w = w;
+  v->h = h;
+  
+  return 0;
+}
+
+/* Upload the rows of the frame that differ from the texture.
+ * The frames are 0x00RRGGBB with a color key : the key becomes a null
+ * alpha, the colors get an opaque one.
+ * Return 1 if the texture changed, 0 otherwise, -1 on error.
+ */
+Sint32 upload(Viewer * v, SDL_Surface * sfc) {
+  Uint64 t = SDL_GetPerformanceCounter();
+  Uint32 key = OPAQUE;
+  Uint32 w = sfc->w < v->w ? sfc->w : v->w;
+  Uint32 h = sfc->h < v->h ? sfc->h : v->h;
+  Uint32 y0, y1, x, y;
+  Uint32 * src;
+  Uint32 * dst;
+  SDL_Rect r;
+  void * pixels;
+  int pitch;
+  
+  if (SDL_MUSTLOCK(sfc))
+    SDL_LockSurface(sfc);
+  
+  for (y0 = 0; y0 < h; y0++)
+    if (memcmp((Uint8 *)sfc->pixels + y0 * sfc->pitch, v->prev + y0 * v->w,
+               w * sizeof *v->prev) != 0)
+      break;
+  for (y1 = h; y1 > y0; y1--)
+    if (memcmp((Uint8 *)sfc->pixels + (y1 - 1) * sfc->pitch,
+               v->prev + (y1 - 1) * v->w, w * sizeof *v->prev) != 0)
+      break;
+  
+  if (y0 == y1) {
+    if (SDL_MUSTLOCK(sfc))
+      SDL_UnlockSurface(sfc);
+    return 0;
+  }
+  
+  r.x = 0;
+  r.y = y0;
+  r.w = w;
+  r.h = y1 - y0;
+  if (SDL_LockTexture(v->tex, &r, &pixels, &pitch) < 0) {
+    fprintf(stderr, "SDL_LockTexture : %s\n", SDL_GetError());
+    if (SDL_MUSTLOCK(sfc))
+      SDL_UnlockSurface(sfc);
+    return -1;
+  }
+  
+  SDL_GetColorKey(sfc, &key);
+  for (y = y0; y < y1; y++) {
+    src = (Uint32 *)((Uint8 *)sfc->pixels + y * sfc->pitch);
+    dst = (Uint32 *)((Uint8 *)pixels + (y - y0) * pitch);
+    for (x = 0; x < w; x++)
+      dst[x] = src[x] == key ? 0 : src[x] | OPAQUE;
+    memcpy(v->prev + y * v->w, src, w * sizeof *v->prev);
+  }
+  
+  SDL_UnlockTexture(v->tex);
+  if (SDL_MUSTLOCK(sfc))
+    SDL_UnlockSurface(sfc);
+  
+  v->rows += y1 - y0;
+  v->tUpload += SDL_GetPerformanceCounter() - t;
+  
+  return 1;
+}
+
+/* With vsync, SDL_RenderPresent waits for the refresh */
+void present(Viewer * v) {
+  Uint64 t = SDL_GetPerformanceCounter();
+  
+  SDL_SetRenderDrawColor(v->ren, (BACKGROUND >> 16) & 0xFF,
+                         (BACKGROUND >> 8) & 0xFF, BACKGROUND & 0xFF, 0xFF);
+  SDL_RenderClear(v->ren);
+  SDL_RenderCopy(v->ren, v->tex, NULL, NULL);
+  SDL_RenderPresent(v->ren);
+  
+  v->tPresent += SDL_GetPerformanceCounter() - t;
+}
+
+/* Present 'n' frames in a row and print the average costs */
+int bench(Viewer * v, GIF_Surface * img, Uint32 n) {
+  double f = 1e6 / SDL_GetPerformanceFrequency();
+  Uint32 nimg = GIF_GetNumFrames(img);
+  Uint32 i;
+  
+  if (nimg == 0)
+    return EXIT_FAILURE;
+  
+  for (i = 0; i < n; i++) {
+    if (upload(v, GIF_GetFrame(img, i % nimg)) < 0)
+      return EXIT_FAILURE;
+    present(v);
+  }
+  
+  printf("%s : %u frames %ux%u, %u of %u rows uploaded\n",
+         SDL_GetCurrentVideoDriver(), n, v->w, v->h, v->rows,
+         n * v->h);
+  printf("upload %.1f us, present %.1f us per frame\n",
+         v->tUpload * f / n, v->tPresent * f / n);
+  
+  return EXIT_SUCCESS;
+}
+
+void usage(char * name) {
+  fprintf(stderr, "usage : %s [-novsync] [-b frames] file.gif\n", name);
+}
+
+int main(int argc, char ** argv) {
+  Viewer v = { 0 };
+  GIF_Surface * img;
+  SDL_Surface * tmp;
+  SDL_Event e;
+  Uint32 nbench = 0;
+  Uint8 vsync = 1;
+  Uint8 done;
+  Uint8 dirty;
+  Sint32 ret;
+  int i;
+  
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "-novsync") == 0)
+      vsync = 0;
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc - 1)
+      nbench = strtoul(argv[++i], NULL, 10);
+    else
+      break;
+  }
+  if (i != argc - 1) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  
+  /* The benchmark needs no display */
+  if (nbench != 0) {
+    if (getenv("SDL_VIDEODRIVER") == NULL)
+      putenv("SDL_VIDEODRIVER=dummy");
+    vsync = 0;
+  }
+  
+  if (init(&v, vsync) < 0)
+    return EXIT_FAILURE;
+  
+  if (nbench != 0)
+    img = GIF_LoadGIF(argv[i]);
+  else
+    img = GIF_LoadGIFAsync(argv[i], NULL, NULL);
+  if (img == NULL) {
+    fprintf(stderr, "Error: main: Open file failed !\n");
+    return EXIT_FAILURE;
+  }
+  
+  if (nbench != 0) {
+    if (resize(&v, GIF_GetWidth(img), GIF_GetHeight(img)) < 0)
+      return EXIT_FAILURE;
+    ret = bench(&v, img, nbench);
+    GIF_FreeGIF(img);
+    return ret;
+  }
+  
+  done = 0;
+  dirty = 0;
+  while (!done) {
+    while (SDL_PollEvent(&e)) {
+      if (e.type == SDL_QUIT ||
+          (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE))
+        done = 1;
+      if (e.type == SDL_WINDOWEVENT &&
+          e.window.event == SDL_WINDOWEVENT_EXPOSED)
+        dirty = 1;
+    }
+    tmp = GIF_GetNextFrame(img);
+    if (tmp == NULL) {
+      if (GIF_GetLoadState(img) == GIF_FAILED) {
+        fprintf(stderr, "Error: main: Decoding failed !\n");
+        GIF_FreeGIF(img);
+        return EXIT_FAILURE;
+      }
+      SDL_Delay(1);
+      continue;
+    }
+    
+    // Resize to match the size of the gif once the first frame is there
+    if (v.tex == NULL &&
+        resize(&v, GIF_GetWidth(img), GIF_GetHeight(img)) < 0) {
+      GIF_FreeGIF(img);
+      return EXIT_FAILURE;
+    }
+    
+    ret = upload(&v, tmp);
+    if (ret < 0) {
+      GIF_FreeGIF(img);
+      return EXIT_FAILURE;
+    }
+    
+    /* Same frame : nothing to present until the next one is due */
+    if (ret == 0 && !dirty) {
+      SDL_Delay(1);
+      continue;
+    }
+    present(&v);
+    dirty = 0;
+  }
+  
+  GIF_FreeGIF(img);
+  free(v.prev);
+  
+  return EXIT_SUCCESS;
+}
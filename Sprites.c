@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "GIF_Sprites.h"
+
+
+/* Sprites [-ppm] file.gif sheet table
+ * Write the unique frames of the animation packed in a sprite sheet (raw
+ * RGBA by default) and the table placing them, see GIF_Sprites.h.
+ */
+
+enum {
+  SDL_FLAGS = SDL_INIT_VIDEO
+};
+
+
+
+Sint32 init(void) {
+  /* No window is opened, the canvases don't depend on the display */
+  if (getenv("SDL_VIDEODRIVER") == NULL)
+    putenv("SDL_VIDEODRIVER=dummy");
+  
+  if (SDL_Init(SDL_FLAGS) < 0) {
+    fprintf(stderr, "SDL_Init : %s\n", SDL_GetError());
+    return -1;
+  }
+  atexit(SDL_Quit);
+  
+  return 0;
+}
+
+void usage(char * name) {
+  fprintf(stderr, "usage : %s [-ppm] file.gif sheet table\n", name);
+}
+
+int main(int argc, char ** argv) {
+  Uint32 format = GIF_SPRITES_RGBA;
+  GIF_Surface * gif;
+  FILE * sheet;
+  FILE * table;
+  Uint16 w, h;
+  Uint32 nimg;
+  int i, n;
+  
+  i = 1;
+  if (i < argc && strcmp(argv[i], "-ppm") == 0) {
+    format = GIF_SPRITES_PPM;
+    i++;
+  }
+  if (argc - i != 3) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  
+  if (init() < 0)
+    return EXIT_FAILURE;
+  
+  gif = GIF_LoadGIF(argv[i]);
+  if (gif == NULL) {
+    fprintf(stderr, "Error: main: Open file failed !\n");
+    return EXIT_FAILURE;
+  }
+  nimg = GIF_GetNumFrames(gif);
+  
+  sheet = fopen(argv[i + 1], "wb");
+  table = sheet == NULL ? NULL : fopen(argv[i + 2], "wb");
+  if (table == NULL) {
+    perror("fopen");
+    if (sheet != NULL)
+      fclose(sheet);
+    GIF_FreeGIF(gif);
+    return EXIT_FAILURE;
+  }
+  
+  /* The last writes can only fail when the files are closed */
+  n = GIF_WriteSprites(gif, sheet, table, format, &w, &h);
+  if (fclose(sheet) != 0 && n >= 0) {
+    perror(argv[i + 1]);
+    n = -1;
+  }
+  if (fclose(table) != 0 && n >= 0) {
+    perror(argv[i + 2]);
+    n = -1;
+  }
+  GIF_FreeGIF(gif);
+  
+  if (n < 0) {
+    fprintf(stderr, "Error: main: Conversion failed !\n");
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "%u frames, %d sprites in a %ux%u sheet\n", nimg, n, w, h);
+  
+  return EXIT_SUCCESS;
+}